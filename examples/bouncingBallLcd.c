@@ -67,10 +67,10 @@ int main( int argc, char **argv )
       ball->vely = -ball->vely;
     }
     
-    lcdClear( lcd );
+    lcdScreenClear( lcd ); //Only the cells that changed are sent by lcdFlush, so there is no flicker
 
-    lcdPosition( lcd, ball->x, ball->y );
-    lcdPutChar( lcd, 'o' );
+    lcdScreenPutChar( lcd, ball->x, ball->y, 'o' );
+    lcdFlush( lcd );
     printf( "x, y: %d, %d\n", ball->x, ball->y );
     delay( 1000 );
   }
@@ -0,0 +1,221 @@
+/*
+ * lcdI2cCheck.c:
+ *  Drive the hd44780 driver's i2c transport into a socketpair standing in
+ *  for the PCF8574 backpack, decode the port writes back into RS/data bytes
+ *  and compare them with what was sent. Run by make check
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "jakestering.h"
+#include "lcd.h"
+
+LCD *lcd;
+
+int sockets[ 2 ]; //0 = the lcd's end, 1 = the fake backpack
+
+int port;         //last value written to the PCF8574
+int fourBit;      //controller switched to 4-bit operation
+int highNibble;   //first nibble of a byte, -1 when none is held
+int highRs;
+
+char decoded[ 512 ]; //data bytes as text, instructions as <hh>
+int decodedLength;
+int bytes;
+int failed;
+
+/*
+ * Append a byte the controller latched
+ *
+ * Parameters:
+ *  rs  : 1 = data | 0 = instruction
+ *  data: byte latched
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void decodeByte( int rs, int data )
+{
+  int room = sizeof( decoded ) - decodedLength;
+
+  decodedLength += snprintf( decoded + decodedLength, room, rs ? "%c" : "<%02x>", data );
+  bytes++;
+}
+
+/*
+ * Latch DB4-DB7 on the falling edge of E. Until the function set
+ * clears DL each nibble is a whole 8-bit instruction, after that two
+ * nibbles make a byte, high first.
+ *
+ * Parameters:
+ *  value: port value with E low
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void decodeNibble( int value )
+{
+  int nibble = value >> 4;
+  int rs = value & LCD_I2C_RS;
+
+  if ( !fourBit )
+  {
+    decodeByte( rs, nibble << 4 );
+    fourBit = !rs && nibble == 0b0010; //function set with DL = 0
+    return;
+  }
+
+  if ( highNibble < 0 )
+  {
+    highNibble = nibble;
+    highRs = rs;
+    return;
+  }
+
+  if ( rs != highRs )
+  {
+    printf( "Failed: RS changed between the nibbles of one byte\n" );
+    failed = 1;
+  }
+
+  decodeByte( rs, ( highNibble << 4 ) | nibble );
+  highNibble = -1;
+}
+
+/*
+ * Read every transfer the lcd has sent and compare what the controller
+ * would have latched with what was expected
+ *
+ * Parameters:
+ *  step     : name for failure messages
+ *  expected : decoded bytes, data as text and instructions as <hh>
+ *  backlight: state the backlight bit must have
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void expectDecoded( const char *step, const char *expected, int backlight )
+{
+  unsigned char transfer[ LCD_I2C_BUFFER * 2 ];
+  int length;
+
+  decodedLength = 0;
+  decoded[ 0 ] = '\0';
+
+  while ( ( length = recv( sockets[ 1 ], transfer, sizeof( transfer ), MSG_DONTWAIT ) ) > 0 )
+  {
+    if ( length > LCD_I2C_BUFFER )
+    {
+      printf( "Failed: %s: %d byte transfer\n", step, length );
+      failed = 1;
+    }
+
+    for ( int i = 0; i < length; i++ )
+    {
+      if ( transfer[ i ] & LCD_I2C_RW )
+      {
+        printf( "Failed: %s: RW set, the controller would drive the bus\n", step );
+        failed = 1;
+      }
+
+      if ( ( ( transfer[ i ] & LCD_I2C_BACKLIGHT ) != 0 ) != backlight )
+      {
+        printf( "Failed: %s: backlight bit should be %d\n", step, backlight );
+        failed = 1;
+      }
+
+      if ( ( port & LCD_I2C_E ) && !( transfer[ i ] & LCD_I2C_E ) )
+      {
+        decodeNibble( transfer[ i ] );
+      }
+
+      port = transfer[ i ];
+    }
+
+    if ( highNibble >= 0 )
+    {
+      printf( "Failed: %s: a byte was split across transfers\n", step );
+      failed = 1;
+    }
+  }
+
+  if ( strcmp( decoded, expected ) != 0 )
+  {
+    printf( "Failed: %s: decoded \"%s\", expected \"%s\"\n", step, decoded, expected );
+    failed = 1;
+  }
+}
+
+int main( int argc, char **argv )
+{
+  if ( setupFakeIO( 1 << 10 ) < 0 )
+  {
+    return 1;
+  }
+
+  if ( socketpair( AF_UNIX, SOCK_SEQPACKET, 0, sockets ) < 0 ) //keeps each write() as one transfer
+  {
+    perror( "Failed: socketpair" );
+    return 1;
+  }
+
+  highNibble = -1;
+
+  lcd = initLcdI2cFd( 4, 20, sockets[ 0 ] );
+  expectDecoded( "init", "<30><30><30><20><28><0c><06><01>", 1 );
+
+  lcdPuts( lcd, "Hello, world" );
+  expectDecoded( "puts", "Hello, world", 1 );
+
+  lcdScreenPuts( lcd, 0, 1, "second line" );
+  lcdScreenPuts( lcd, 0, 3, "4th" );
+  lcdFlush( lcd );
+  expectDecoded( "flush", "<c0>second line<d4>4th", 1 );
+
+  lcdClear( lcd );
+  expectDecoded( "clear", "<01><02>", 1 );
+
+  lcdBacklight( lcd, 0 );
+  lcdPuts( lcd, "dark" );
+  expectDecoded( "backlight", "dark", 0 );
+
+  lcdAsyncStart( lcd );
+  lcdPuts( lcd, "async" );
+  lcdAsyncFence( lcd );
+  expectDecoded( "async", "async", 0 );
+
+  closeLcd( lcd );
+  close( sockets[ 1 ] );
+
+  printf( "%s: %d bytes decoded\n", failed ? "FAIL" : "PASS", bytes );
+
+  return failed;
+}
@@ -0,0 +1,108 @@
+/*
+ * lcdModelCheck.c:
+ *  Replay the hd44780 driver on the fake GPIO backend through the timing
+ *  model, failing on any violation or DDRAM mismatch. Run by make check
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "jakestering.h"
+#include "lcd.h"
+#include "lcdModel.h"
+
+LCD *lcd;
+
+LcdModel *model;
+
+int main( int argc, char **argv )
+{
+  int failed = 0;
+
+  if ( setupFakeIO( 1 << 18 ) < 0 )
+  {
+    return 1;
+  }
+
+  lcd = initLcd( 4, 20, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 );
+  model = initLcdModel( 0, -1, 1, 2 );
+
+  if ( model == NULL )
+  {
+    return 1;
+  }
+
+  lcdPosition( lcd, 0, 0 );
+  lcdPuts( lcd, "Jakestering" );
+  lcdPosition( lcd, 5, 2 );
+  lcdPrintf( lcd, "%d ms", 42 );
+
+  lcdScreenPuts( lcd, 0, 1, "Temp: 21.5C" );
+  lcdScreenPuts( lcd, 0, 3, "Hum: 40%" );
+  lcdFlush( lcd );
+  lcdScreenPuts( lcd, 6, 1, "22.0" );
+  lcdFlush( lcd );
+
+  for ( int i = 0; i < 30; i++ ) //row 0 now starts at DDRAM 30 and wraps to 0x00 after 10 cells
+  {
+    lcdMarqueeStep( lcd, 1 );
+  }
+
+  lcdScreenPuts( lcd, 0, 0, "ABCDEFGHIJKLMNOPQRST" );
+  lcdFlush( lcd );
+
+  if ( lcdFlush( lcd ) != 0 )
+  {
+    printf( "Failed: a shifted row needed a second flush\n" );
+    failed = 1;
+  }
+
+  if ( jakesteringBusLog()->dropped > 0 )
+  {
+    printf( "Failed: bus log dropped %d writes\n", jakesteringBusLog()->dropped );
+    return 1;
+  }
+
+  lcdModelRun( model, jakesteringBusLog() );
+
+  if ( lcdModelViolations( model ) != 0 )
+  {
+    lcdModelReport( model );
+    failed = 1;
+  }
+
+  if ( memcmp( model->ddram, "KLMNOPQRST", 10 ) != 0 )
+  {
+    printf( "Failed: the shifted row did not wrap to DDRAM 0x00\n" );
+    failed = 1;
+  }
+
+  if ( memcmp( model->ddram, lcd->ddram, sizeof( model->ddram ) ) != 0 )
+  {
+    printf( "Failed: model DDRAM differs from the driver's shadow\n" );
+    failed = 1;
+  }
+
+  printf( "%s: %d writes replayed\n", failed ? "FAIL" : "PASS", model->writes );
+
+  return failed;
+}
@@ -29,6 +29,7 @@
 
 #include "jakestering.h"
 #include "lcd128x64.h"
+#include "lcd128Font.h"
 
 typedef struct _ball
 {
@@ -72,16 +73,18 @@ int main( int argc, char **argv )
   
   setupIO();
 
-  lcd = initLcd128( 0, 1, 2,  3, 4, 5, 6, 7, 8, 9, 10, 11, 12 ); //Initalize the 128x64 lcd
+  lcd = initLcd128( 0, 1, 2,  3, 4, 5, 6, 7, 8, 9, 12 ); //Initalize the 128x64 lcd
   
   ball = ballInit( 64, 24, 8, 0.89f );
   
   paddleLeft = paddleInit( 8, 24, 8, 40, 8 ); 
   paddleRight = paddleInit( 120, 24, 120, 40, -8 ); 
 
-  setGraphicsMode( lcd );
+  setGraphicsMode( lcd ); //Set once, the text overlay is shown on top of the graphics
 
   lcd128ClearGraphics( lcd );
+
+  lcd128SetFont( lcd, &lcd128Font5x7, 1, 1 );
   
   left = 0;
   right = 0;
@@ -159,8 +162,6 @@ int main( int argc, char **argv )
   //  ball->velx *= ball->friction;
   //  ball->vely *= ball->friction;
 
-    setGraphicsMode( lcd ); //Have to set graphics mode if you want to draw graphics
-
     lcd128DrawPixel( lcd, ball->x, ball->y );
 
     lcd128DrawLine( lcd, paddleLeft->x1, paddleLeft->y1, paddleLeft->x2, paddleLeft->y2 );
@@ -168,35 +169,25 @@ int main( int argc, char **argv )
 
     lcd128DrawLine( lcd, 64, 0, 64, 64 );
 
-    lcd128UpdateScreen( lcd ); //This updates the screen with the current frame buffer
-
-    setTextMode( lcd ); //Have to set text mode if you want to draw text
-
-    lcd128CursorPosition( lcd, 3, 0 );
-    lcd128Printf( lcd, 0, "%d", left );
+    lcd128OverlayPrintf( lcd, 6, 0, "%d", left ); //Scores either side of the net, as DDRAM text over the graphics
+    lcd128OverlayPrintf( lcd, 9, 0, "%d", right );
 
-    lcd128CursorPosition( lcd, 4, 0 );
-    lcd128Printf( lcd, 1, "%d", right );
-
-    if ( right >= 9 ) //Check which side has won
+    if ( right >= 9 || left >= 9 ) //Check which side has won
     {
-      lcd128ClearText( lcd );
-      lcd128CursorPosition(lcd, 2, 1 );
-      lcd128Puts( lcd, "Winner!", 0 );
-      lcd128CursorPosition(lcd, 3, 2 );
-      lcd128Printf( lcd, 0, "Right: %d", right );
+      lcd128OverlayClear( lcd );
+      lcd128SetFont( lcd, &lcd128Font5x7, 2, 1 );
+      lcd128DrawMode( lcd, LCD128_DRAW_CLEAR );
+      lcd128DrawFilledRect( lcd, 16, 14, 96, 36 );
+      lcd128DrawMode( lcd, LCD128_DRAW_SET );
+      lcd128DrawRect( lcd, 16, 14, 96, 36 );
+      lcd128DrawText( lcd, 64 - lcd128TextWidth( lcd, "Winner!" ) / 2, 18, "Winner!" );
+      lcd128SetFont( lcd, &lcd128Font5x7, 1, 1 );
+      lcd128DrawTextf( lcd, 40, 38, ( right >= 9 ) ? "Right: %d" : "Left: %d", ( right >= 9 ) ? right : left );
+      lcd128Present( lcd );
       break;
     }
 
-    else if( left >= 9 )
-    {
-      lcd128ClearText( lcd );
-      lcd128CursorPosition(lcd, 2, 1 );
-      lcd128Puts( lcd, "Winner!", 0 );
-      lcd128CursorPosition(lcd, 3, 2 );
-      lcd128Printf( lcd, 0, "Left: %d", left );
-      break;
-    }
+    lcd128Present( lcd ); //Sends what changed in the frame buffer and the text overlay
   }
 
   free( lcd );
@@ -0,0 +1,58 @@
+/*
+ * terminalLcd.c:
+ *  Example of piping output to the hd44780 lcd through the terminal layer
+ *    e.g. dmesg -w | ./terminalLcd
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "jakestering.h"
+#include "lcd.h"
+#include "lcdTerm.h"
+
+LCD *lcd;
+
+LcdTerm *term;
+
+int main( int argc, char **argv )
+{
+  setupIO();
+
+  lcd = initLcd( 4, 20, 0, 1, 2,  3, 4, 5, 6, 7, 8, 9 );
+
+  term = initLcdTerm( lcd );
+
+  if ( term == NULL )
+  {
+    return 1;
+  }
+
+  lcdTermRun( term, STDIN_FILENO );
+
+  free( term );
+  free( lcd );
+
+  return 0;
+}
+
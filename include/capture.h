@@ -0,0 +1,86 @@
+/*
+ * capture.h:
+ *  Logic analyzer capture of the GPIO level register
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ * One run of unchanged levels
+ *  delta : samples since the previous record
+ *  levels: GPLEV0 masked to the captured pins
+ */
+
+typedef struct _captureRecord
+{
+  uint32_t delta;
+  uint32_t levels;
+} CaptureRecord;
+
+typedef struct _capture
+{
+  uint32_t pinMask;        // pins to record, bit n = GPIO n
+  int cpu;                 // core the sampler is pinned to, -1 for any
+  int priority;            // real-time priority for the sampler, 0 keeps normal scheduling
+
+  CaptureRecord *records;  // ring buffer, oldest records are overwritten
+  size_t size;             // power of two
+  uint64_t head;           // records written so far
+
+  uint32_t triggerMask;
+  uint32_t triggerValue;
+  size_t postRecords;      // records kept after the trigger
+  int triggered;
+  uint64_t triggerIndex;
+
+  uint64_t samples;        // samples taken, for the sample period
+  uint64_t startNs;
+  uint64_t stopNs;
+
+  volatile int running;
+  pthread_t thread;
+  int joinable;            // thread started and not joined yet
+} Capture;
+
+Capture *initCapture( size_t records, uint32_t pinMask, int cpu );
+
+void captureTrigger( Capture *cap, uint32_t mask, uint32_t value, size_t postRecords );
+
+int captureStart( Capture *cap );
+
+void captureWait( Capture *cap );
+
+void captureStop( Capture *cap );
+
+double captureSamplePeriod( Capture *cap );
+
+int captureExportVcd( Capture *cap, const char *path );
+
+void freeCapture( Capture *cap );
+
+#endif
+
@@ -0,0 +1,96 @@
+/*
+ * debounce.h:
+ *  Non-blocking debounce and glitch filter for buttons and switches
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __DEBOUNCE_H__
+#define __DEBOUNCE_H__
+
+#include <stdint.h>
+
+#define DEBOUNCE_WHEEL_SLOTS 256 //must be a power of two, one slot per milli second
+#define DEBOUNCE_MAX_INPUTS  256
+
+/*
+ * Events passed to an input's callback
+ *  PRESS     : input settled at its active level
+ *  RELEASE   : input settled back at its inactive level
+ *  LONG_PRESS: input held active for longPressMs
+ *  REPEAT    : fired every repeatMs while held after a long press
+ */
+
+#define DEBOUNCE_PRESS      0
+#define DEBOUNCE_RELEASE    1
+#define DEBOUNCE_LONG_PRESS 2
+#define DEBOUNCE_REPEAT     3
+
+typedef struct _debounceTimer
+{
+  uint64_t expires;
+  int slot;                      // wheel slot, -1 when not scheduled
+  int input;                     // index of the owning input
+  int hold;                      // 0 = settle timer | 1 = hold timer
+  struct _debounceTimer *next;
+  struct _debounceTimer *prev;
+  struct _debounceTimer *fire;   // link while queued for firing
+} DebounceTimer;
+
+typedef struct _debounceInput
+{
+  int key;                       // pin number or any id the caller chooses
+  int activeLevel;               // level that counts as pressed
+  int settleMs;                  // raw level must be unchanged this long
+  int minPulseMs;                // pulses narrower than this are dropped
+  int longPressMs;               // 0 disables long press
+  int repeatMs;                  // 0 disables repeat
+
+  int raw;
+  int stable;
+  int repeating;                 // long press already reported
+  uint64_t lastEdge;
+  uint64_t prevEdge;
+
+  DebounceTimer settle;
+  DebounceTimer hold;
+
+  void (*function)( int key, int event );
+} DebounceInput;
+
+typedef struct _debouncer
+{
+  uint64_t tick;
+  DebounceTimer *wheel[ DEBOUNCE_WHEEL_SLOTS ];
+  int table[ DEBOUNCE_MAX_INPUTS * 2 ];       // key hash -> input index + 1
+  DebounceInput inputs[ DEBOUNCE_MAX_INPUTS ];
+  int count;
+} Debouncer;
+
+Debouncer *initDebouncer( uint64_t nowMs );
+
+int debounceAdd( Debouncer *db, int key, int activeLevel, int settleMs, int minPulseMs, int longPressMs, int repeatMs, void (*function)( int key, int event ) );
+
+void debounceUpdate( Debouncer *db, int key, int level, uint64_t nowMs );
+
+void debounceTick( Debouncer *db, uint64_t nowMs );
+
+#endif
+
@@ -0,0 +1,57 @@
+/*
+ * encoder.h:
+ *  Quadrature rotary encoder decoder
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __ENCODER_H__
+#define __ENCODER_H__
+
+#include <stdint.h>
+
+#define ENCODER_IDLE_NS 100000000 //velocity reads 0 after 100 ms without a step
+
+typedef struct _encoder
+{
+  int A; // phase A
+  int B; // phase B
+
+  int state;               // last AB state, bit 1 = A | bit 0 = B
+  int64_t position;        // steps, 4 per quadrature cycle
+  uint64_t lastTimestamp;  // kernel timestamp of the last step in ns
+  int64_t periodNs;        // smoothed time per step, negative when turning backwards
+  uint32_t errors;         // edges that repeated their phase's level, the other edge was lost
+} Encoder;
+
+Encoder *initEncoder( int A, int B );
+
+void closeEncoder( Encoder *enc );
+
+int64_t encoderPosition( Encoder *enc );
+
+void encoderSetPosition( Encoder *enc, int64_t position );
+
+double encoderVelocity( Encoder *enc );
+
+uint32_t encoderErrors( Encoder *enc );
+
+#endif
+
@@ -0,0 +1,41 @@
+/*
+ * gpioUring.h:
+ *  io_uring backend for GPIO edge event ingestion
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __GPIO_URING_H__
+#define __GPIO_URING_H__
+
+int gpioUringInit( const unsigned entries );
+
+int gpioUringFd( void );
+
+int gpioUringArm( const int pin );
+
+int gpioUringCancel( const int pin );
+
+int gpioUringDispatch( const int wait );
+
+void gpioUringClose( void );
+
+#endif
+
@@ -25,6 +25,8 @@
 #ifndef __JAKESTERING_H__
 #define __JAKESTERING_H__
 
+#include <stdint.h>
+
 #define BCM2835_BASE 0x20000000
 #define GPIO_BASE ( BCM2835_BASE + 0x200000 )
 
@@ -39,6 +41,7 @@
 #define GPIO_CLR *( gpio + 10 )
 
 #define GPIO_LEV( g ) ( *( gpio + 13 ) & ( 1 << g ) )
+#define GPIO_LEV0 *( gpio + 13 )
 
 #define GPIO_EDS  *( gpio + 16 )
 #define GPIO_REN  *( gpio + 19 )
@@ -74,6 +77,42 @@
 
 #define MAX_BUFFER 32 
 
+/*
+ * Bus write log kept by the fake register backend. Each digitalWrite or
+ * digitalWriteByte is one entry.
+ */
+
+typedef struct _busWrite
+{
+  uint64_t nanos;  // CLOCK_MONOTONIC time of the write
+  uint32_t set;    // GPSET0 bits
+  uint32_t clear;  // GPCLR0 bits
+  uint32_t levels; // output levels after the write
+} BusWrite;
+
+/*
+ * Parallel bus timing. Drivers start from worst case values that
+ * jakesteringCalibrate can shrink for a particular panel.
+ */
+
+typedef struct _busTiming
+{
+  int enableNanos; // E high pulse width
+  int holdNanos;   // wait after E falls
+  int gapNanos;    // wait for the controller between bytes
+} BusTiming;
+
+#define CALIBRATE_REPEATS    3  //passes a candidate timing needs in a row
+#define CALIBRATE_RESOLUTION 20 //ns, binary search stops this close
+
+typedef struct _busLog
+{
+  BusWrite *writes;
+  int size;
+  int count;
+  int dropped;     // writes lost once the log filled up
+} BusLog;
+
 extern int memFd; // /dev/mem
 
 extern void* gpioMap; //Pointer to the GPIO memory map
@@ -82,10 +121,24 @@ extern volatile unsigned *gpio; //Access to the input / output
 
 void setupIO(); //Setup function to create memory regions to access the GPIO
 
+int setupFakeIO( const int logSize ); //Point the GPIO registers at plain memory, for running without hardware
+
+BusLog* jakesteringBusLog( void );
+
+void jakesteringBusLogClear( void );
+
 void delay(int milliSeconds);
 
 void delayMicro(int microSeconds);
 
+void delayNano( int nanoSeconds );
+
+uint64_t nanos( void );
+
+uint64_t micros( void );
+
+uint64_t millis( void );
+
 void pinMode( const int pin, const int mode );
 
 void pudController( const int pin, const int PUD );
@@ -103,6 +156,21 @@ int wait_for_interrupt_to_close( const int pin );
 int interrupt_init( const int pin, const int mode );
 int jakestering_ISR( const int pin, const int mode, void (*function)(void) );
 
+int jakesteringPollFd( void );
+int jakesteringPollISR( const int pin, const int mode, void (*function)(void) );
+int jakesteringPollEvent( const int pin, const int mode, void (*function)( int pin, int edge, uint64_t timestamp, void *arg ), void *arg );
+int jakesteringPollEventLines( const int *pins, const int count, const int mode, void (*function)( int pin, int edge, uint64_t timestamp, void *arg ), void *arg );
+int jakesteringDispatchPending( void );
+int jakesteringPollClose( const int pin );
+uint32_t jakesteringPollPins( void );
+int jakesteringLineFd( const int pin );
+void jakesteringDispatchEvent( const int pin, const uint32_t id, const uint64_t timestamp );
+int jakesteringDispatchRead( const int pin, const void *buffer, const int bytes );
+
+int jakesteringCalibrate( BusTiming *timing, const BusTiming *safe, int (*test)( void *device ), void *device, const int margin );
+int jakesteringSaveTiming( const BusTiming *timing, const char *path );
+int jakesteringLoadTiming( BusTiming *timing, const char *path );
+
 int piHiPri (const int pri);
 #endif
 
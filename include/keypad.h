@@ -25,6 +25,13 @@
 #ifndef __KEYPAD_H__
 #define __KEYPAD_H__
 
+#include <stdint.h>
+
+#include "debounce.h"
+
+#define KEYPAD_KEY_BASE 0x100 //keeps keypad keys clear of GPIO pin numbers in a shared Debouncer
+#define KEYPAD_KEY( row, col ) ( KEYPAD_KEY_BASE + ( row ) * 4 + ( col ) )
+
 typedef struct _keypad
 {
   int COLS[ 4 ];
@@ -35,5 +42,11 @@ Keypad initKeypad( int c0, int c1, int c2, int c3, int r0, int r1, int r2, int r
 
 char checkKeypad( Keypad kp, int pageNumber );
 
+int keypadDebounce( Debouncer *db, int settleMs, int longPressMs, int repeatMs, void (*function)( int key, int event ) );
+
+void scanKeypad( Keypad kp, Debouncer *db, uint64_t nowMs );
+
+char keypadKeyChar( int key, int pageNumber );
+
 #endif
 
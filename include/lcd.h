@@ -25,6 +25,12 @@
 #ifndef __LCD_H__
 #define __LCD_H__
 
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "jakestering.h"
+
 #define LCD_CLEAR        0b00000001  //Clear display
 #define LCD_HOME         0b00000010  //Return home
 #define LCD_ENTRY        0b00000100  //Set entry mode
@@ -34,6 +40,28 @@
 #define LCD_CGRAM        0b01000000  //Character generator ram
 #define LCD_DDRAM        0b10000000  //Display data ram
 
+/*
+ * Execution times, used when the RW line is not wired and the busy flag
+ * cannot be read
+ */
+
+#define LCD_EXEC_MICRO       41  //37us for every instruction and data write plus tADD
+#define LCD_EXEC_HOME_MICRO  1520 //Clear display and return home
+#define LCD_BUSY_TIMEOUT     10000 //Give up polling the busy flag after 10 ms
+#define LCD_ENABLE_NANOS     1000  //E pulse width before calibration
+#define LCD_HOLD_NANOS       5000  //Wait after E falls before calibration
+
+#define LCD_DDRAM_SIZE 128 //2-line mode uses 0x00-0x27 and 0x40-0x67
+#define LCD_MAX_ROWS   4
+#define LCD_MAX_COLS   40
+#define LCD_LINE_LENGTH 40 //DDRAM cells per line, the display shift wraps at this
+
+#define LCD_QUEUE_SIZE 256 //must be a power of two
+
+#define LCD_I2C_BUFFER 128 //bytes per i2c transfer, every byte sent to the lcd takes 4
+
+#define LCD_GLYPH_SLOTS 8 //CGRAM characters, codes 0-7 mirrored at 8-15
+
 /*
  * Entry mode parameters
  *  I/D: Increment or Decrement address registers
@@ -63,6 +91,20 @@
 #define LCD_SC_SHIFT     0b00001000
 #define LCD_RL_SHIFT     0b00000100
 
+/*
+ * PCF8574 backpack wiring
+ *  P0   : RS
+ *  P1   : RW
+ *  P2   : E
+ *  P3   : backlight
+ *  P4-P7: DB4-DB7
+ */
+
+#define LCD_I2C_RS        0b00000001
+#define LCD_I2C_RW        0b00000010
+#define LCD_I2C_E         0b00000100
+#define LCD_I2C_BACKLIGHT 0b00001000
+
 /*
  * Function set
  *  DL: Data length 1 = 8-bits | 0 = 4-bits
@@ -74,9 +116,38 @@
 #define N_FUNC           0b00001000
 #define F_FUNC           0b00000100
 
+/*
+ * Command queued for the async writer thread. sequence orders the slot
+ * between producers and the writer, so the queue needs no lock.
+ */
+
+typedef struct _lcdCommand
+{
+  unsigned int sequence;
+  int type;
+  int x;
+  int y;
+  int value;
+} LcdCommand;
+
+typedef struct _lcdQueue
+{
+  LcdCommand commands[ LCD_QUEUE_SIZE ];
+  unsigned int enqueue;          // next slot for producers
+  unsigned int dequeue;          // next slot for the writer
+  sem_t wake;                    // posted once per queued command
+  pthread_t writer;
+
+  pthread_mutex_t fenceLock;
+  pthread_cond_t fenceCond;
+  unsigned int fenceIssued;
+  unsigned int fenceDone;
+} LcdQueue;
+
 typedef struct _lcd
 {
   int RS;
+  int RW; // -1 when tied to ground
   int E;
   int DB0;
   int DB1;
@@ -90,16 +161,59 @@ typedef struct _lcd
   int cy;
   int rows;
   int cols;
+
+  BusTiming timing;                                     // gapNanos stands in for the busy flag once calibrated below LCD_EXEC_MICRO
+
+  void ( *transportWrite )( struct _lcd *lcd, const int rs, const int data, const int execMicro ); // parallel GPIO or i2c
+  void ( *transportFlush )( struct _lcd *lcd );                                                  // send held back writes, NULL when none are held
+  int batch;                                            // nesting depth of calls whose writes go out in one transfer
+
+  struct _lcdBus *bus;                                  // shared bus the writes are queued on, NULL when wired alone
+  int busSlot;
+
+  int i2cFd;                                            // /dev/i2c-N or a fake endpoint, -1 when parallel
+  int backlight;
+  unsigned char i2cBuffer[ LCD_I2C_BUFFER ];
+  int i2cLength;
+
+  unsigned char ddram[ LCD_DDRAM_SIZE ];                // shadow of the controller's DDRAM, by address
+  unsigned char screen[ LCD_MAX_ROWS ][ LCD_MAX_COLS ]; // virtual screen sent by lcdFlush
+  int address;                                          // controller address counter, -1 when unknown
+  int increment;                                        // entry mode I/D
+  int shift;                                            // display shift in cells, 0 to LCD_LINE_LENGTH - 1
+  int control;                                          // last display on/off control instruction
+
+  LcdQueue *queue;                                      // async writer, NULL when calls are synchronous
+
+  uint64_t glyphs[ LCD_GLYPH_SLOTS ];                   // bitmap loaded in each CGRAM slot, 5 bits per row
+  unsigned int glyphUsed[ LCD_GLYPH_SLOTS ];            // LRU stamp, 0 when the slot is empty
+  unsigned int glyphClock;
+
+  int marqueeDirection;                                 // 1 = text moves left | -1 = right | 0 = stopped
+  unsigned int marqueePeriod;                           // ms between steps
+  uint64_t marqueeNext;                                 // ms timestamp of the next step
 } LCD;
 
 LCD* initLcd( int rows, int cols, int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7 );
 
+LCD* initLcdRW( int rows, int cols, int RS, int RW, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7 );
+
+LCD* initLcdI2c( int rows, int cols, const char *device, int address );
+
+LCD* initLcdI2cFd( int rows, int cols, int fd );
+
+void closeLcd( LCD *lcd );
+
 void pulseEnable( LCD *lcd );
 
 void sendData( LCD *lcd, const int data );
 
 void sendInstruction( LCD *lcd, const int instruction );
 
+void lcdWaitReady( LCD *lcd, const int execMicro );
+
+int lcdCalibrate( LCD *lcd, int margin );
+
 void lcdPutChar( LCD *lcd, unsigned char character );
 
 void lcdPuts( LCD *lcd, const char* string );
@@ -116,5 +230,35 @@ void lcdCursor( LCD *lcd, int value );
 
 void lcdCursorBlink( LCD *lcd, int value );
 
+void lcdBacklight( LCD *lcd, int value );
+
+void lcdLoadGlyph( LCD *lcd, int slot, uint64_t bitmap );
+
+void lcdScreenClear( LCD *lcd );
+
+void lcdScreenPutChar( LCD *lcd, int x, int y, unsigned char character );
+
+void lcdScreenPuts( LCD *lcd, int x, int y, const char *string );
+
+void lcdScreenPrintf( LCD *lcd, int x, int y, const char *string, ... );
+
+int lcdFlush( LCD *lcd );
+
+int lcdMarqueeLoad( LCD *lcd, int line, const char *string );
+
+void lcdMarqueeStep( LCD *lcd, int direction );
+
+void lcdMarqueeStart( LCD *lcd, int direction, unsigned int periodMs, uint64_t nowMs );
+
+int lcdMarqueeTick( LCD *lcd, uint64_t nowMs );
+
+void lcdMarqueeStop( LCD *lcd, int home );
+
+int lcdAsyncStart( LCD *lcd );
+
+void lcdAsyncFence( LCD *lcd );
+
+void lcdAsyncStop( LCD *lcd );
+
 #endif
 
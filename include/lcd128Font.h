@@ -0,0 +1,63 @@
+/*
+ * lcd128Font.h:
+ *  Bitmap fonts drawn into the LCD128 graphics buffer
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __LCD_128_FONT_H__
+#define __LCD_128_FONT_H__
+
+#include <stdint.h>
+
+#include "lcd128x64.h"
+
+#define LCD128_FONT_MAX_SCALE 4  //largest integer scale
+#define LCD128_FONT_CACHE     64 //glyph bitmaps kept, must be a power of two
+
+/*
+ * Glyphs stored a column per byte, top row in bit 0, width bytes per
+ * character from first to first + count - 1
+ */
+
+typedef struct _lcd128Font
+{
+  const uint8_t *columns;
+  int first;
+  int count;
+  int width;   // columns per glyph, up to 8
+  int height;  // rows, up to 8
+  int spacing; // blank columns after each glyph
+} Lcd128Font;
+
+extern const Lcd128Font lcd128Font5x7;
+
+void lcd128SetFont( LCD128 *lcd, const Lcd128Font *font, int scale, int proportional );
+
+int lcd128DrawChar( LCD128 *lcd, int x, int y, unsigned char character );
+
+int lcd128DrawText( LCD128 *lcd, int x, int y, const char *string );
+
+int lcd128DrawTextf( LCD128 *lcd, int x, int y, const char *string, ... );
+
+int lcd128TextWidth( LCD128 *lcd, const char *string );
+
+#endif
+
@@ -27,6 +27,8 @@
 
 #include <stdint.h>
 
+#include "jakestering.h"
+
 //Instruction set 1: Basic
 #define LCD128_DISPLAY_CLEAR     0b00000001
 #define LCD128_RETURN_HOME       0b00000010
@@ -60,14 +62,86 @@
 
 #define LCD128_G_FUNCTION        0b00000010 //Graphics on/off
 
+#define LCD128_EXEC_CLEAR_NANOS 1600000 //Display clear execution time
+
 #define LCD128_WIDTH  128
 #define LCD128_HEIGHT  64
 
 #define LCD128_PIXELS ( LCD128_WIDTH * ( LCD128_HEIGHT / 8 ) )
+#define LCD128_WORDS  ( LCD128_WIDTH / 16 ) //GDRAM words per row, 16 pixels each
+
+/*
+ * 1bpp frame, 1 KB. words match GDRAM, the leftmost pixel of each in
+ * bit 15; pairs and longs view the same rows for whole-row diffs, clears
+ * and blits.
+ */
+
+typedef union _lcd128Frame
+{
+  uint16_t words[ LCD128_HEIGHT ][ LCD128_WORDS ];
+  uint32_t pairs[ LCD128_HEIGHT ][ LCD128_WORDS / 2 ];
+  uint64_t longs[ LCD128_HEIGHT ][ LCD128_WORDS / 4 ];
+} __attribute__( ( aligned( 64 ) ) ) Lcd128Frame;
+
+#define LCD128_MAX_POLYGON 32 //vertices lcd128DrawFilledPolygon takes
+
+#define LCD128_CLIP_DEPTH 8 //clip rects lcd128PushClip can nest
+#define LCD128_GUARD ( 1 << 20 ) //lines are clipped exactly while every end is within this of the origin
+
+#define LCD128_DRAW_SET   0 //Draw mode: pixels drawn are turned on
+#define LCD128_DRAW_CLEAR 1 //Draw mode: pixels drawn are turned off
+#define LCD128_DRAW_XOR   2 //Draw mode: pixels drawn are flipped
+
+#define LCD128_TEXT_ROWS 4  //DDRAM text lines
+#define LCD128_TEXT_COLS 16 //half width characters per line, two per DDRAM address
+
+#define LCD128_BLIT_COPY   0 //Raster op: destination = source
+#define LCD128_BLIT_OR     1 //Raster op: destination | source
+#define LCD128_BLIT_AND    2 //Raster op: destination & source
+#define LCD128_BLIT_XOR    3 //Raster op: destination ^ source
+#define LCD128_BLIT_ANDNOT 4 //Raster op: destination & ~source
+
+#define LCD128_FLIP_X 0b01 //Blit mirrored left to right
+#define LCD128_FLIP_Y 0b10 //Blit mirrored top to bottom
+
+#define LCD128_ENABLE_NANOS 1000  //E pulse width before calibration
+#define LCD128_HOLD_NANOS   5000  //Wait after E falls before calibration
+#define LCD128_GAP_NANOS    72000 //Wait before each byte before calibration
+
+/*
+ * 1bpp image, rows top down, leftmost pixel in bit 7 of each byte.
+ * Where a mask is given only its set pixels are blitted.
+ */
+
+typedef struct _lcd128Bitmap
+{
+  int width;
+  int height;
+  int stride;          // bytes per row
+  const uint8_t *bits;
+  const uint8_t *mask; // same layout as bits, NULL blits every pixel
+} Lcd128Bitmap;
+
+typedef struct _lcd128Sheet
+{
+  const Lcd128Bitmap *bitmap;
+  int frameWidth;
+  int frameHeight;
+  int columns; // frames per row, numbered left to right then top down
+} Lcd128Sheet;
+
+typedef struct _lcd128Clip
+{
+  int left;   // inclusive, left > right when nothing can be drawn
+  int top;
+  int right;
+  int bottom;
+} Lcd128Clip;
 
 typedef struct _lcd128
 {
   int  RS; // register select
+  int  RW; // read/write, -1 when tied to ground
   int   E; // enable
   int DB0; // data lines 0-7
   int DB1;
@@ -86,13 +160,47 @@ typedef struct _lcd128
   int cols;
   int rows;
 
-  uint16_t buffer [ LCD128_HEIGHT ][ LCD128_WIDTH / 8 ];
-  uint16_t current[ LCD128_HEIGHT ][ LCD128_WIDTH / 8 ];
+  BusTiming timing;
+
+  int extended; // instruction set last selected, 1 = extended | 0 = basic | -1 unknown
+  int graphics; // G bit last set, 1 = GDRAM shown | 0 = hidden | -1 unknown
+
+  int scroll;      // vertical scroll offset rows are drawn at, 0-63
+  int scrollShown; // offset last sent to the controller
+  int scrollRam;   // SR bit last set, 1 = scroll address | 0 = IRAM address
+
+  struct _lcdBus *bus; // shared bus the writes are queued on, NULL when wired alone
+  int busSlot;
+
+  Lcd128Frame buffer;  // frame being drawn
+  Lcd128Frame current; // what GDRAM holds
+
+  uint8_t dirty[ LCD128_HEIGHT ]; // per row, bit n set when word n of buffer may differ from current
+  uint64_t dirtyRows;             // bit y set when dirty[ y ] is non-zero
+  uint64_t staleRows;             // bit y set when GDRAM under row y is unknown, sent whole
+
+  int retained; // 1 = buffer kept across updates | 0 = cleared after each update
+  int drawMode; // LCD128_DRAW_SET/CLEAR/XOR
+
+  char overlay[ LCD128_TEXT_ROWS ][ LCD128_TEXT_COLS ];     // text shown over the graphics, sent by lcd128Present
+  char overlayShown[ LCD128_TEXT_ROWS ][ LCD128_TEXT_COLS ]; // what DDRAM holds, 0 when unknown
+
+  const struct _lcd128Font *font; // text font, NULL for lcd128Font5x7
+  int fontScale;
+  int fontProportional;
+
+  Lcd128Clip clip;                            // drawing outside is dropped, starts as the screen
+  Lcd128Clip clipStack[ LCD128_CLIP_DEPTH ];  // clips saved by lcd128PushClip
+  int clipDepth;
 
 } LCD128;
 
 LCD128 *initLcd128( int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7, int RST );
 
+LCD128 *initLcd128RW( int RS, int RW, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7, int RST );
+
+int lcd128Calibrate( LCD128 *lcd, int margin );
+
 void pulseEnable128( LCD128 *lcd );
 
 void sendData128( LCD128 *lcd, const int data );
@@ -104,10 +212,22 @@ void setGraphicsMode( LCD128 *lcd );
 
 void lcd128ClearGraphics( LCD128 *lcd );
 
+void lcd128Retained( LCD128 *lcd, int value );
+
+void lcd128DrawMode( LCD128 *lcd, int mode );
+
+int lcd128PushClip( LCD128 *lcd, int x, int y, int width, int height );
+
+int lcd128PopClip( LCD128 *lcd );
+
 void lcd128DrawPixel( LCD128 *lcd, int x, int y );
 
 void lcd128ClearPixel( LCD128 *lcd, int x, int y );
 
+void lcd128DrawSpan( LCD128 *lcd, int x0, int x1, int y );
+
+void lcd128ClearRect( LCD128 *lcd, int x, int y, int width, int height );
+
 void lcd128DrawLine( LCD128 *lcd, int x1, int y1, int x2, int y2 );
 
 void lcd128DrawRect(LCD128 *lcd, int x, int y, int width, int height );
@@ -124,8 +244,18 @@ void lcd128DrawTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, in
 
 void lcd128DrawFilledTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, int y3 );
 
+void lcd128DrawFilledPolygon( LCD128 *lcd, const int *x, const int *y, int count );
+
+void lcd128Blit( LCD128 *lcd, const Lcd128Bitmap *bitmap, int x, int y, int op, int flip );
+
+void lcd128BlitRect( LCD128 *lcd, const Lcd128Bitmap *bitmap, int sx, int sy, int width, int height, int x, int y, int op, int flip );
+
+void lcd128BlitFrame( LCD128 *lcd, const Lcd128Sheet *sheet, int frame, int x, int y, int op, int flip );
+
 void lcd128UpdateScreen( LCD128 *lcd );
 
+void lcd128Scroll( LCD128 *lcd, int lines );
+
 
 void setTextMode( LCD128 *lcd );
 
@@ -133,6 +263,14 @@ void lcd128ClearText( LCD128 *lcd );
 
 void lcd128CursorPosition( LCD128 *lcd, int x, int y );
 
+void lcd128OverlayClear( LCD128 *lcd );
+
+void lcd128OverlayPuts( LCD128 *lcd, int x, int y, const char *string );
+
+void lcd128OverlayPrintf( LCD128 *lcd, int x, int y, const char *string, ... );
+
+void lcd128Present( LCD128 *lcd );
+
 void lcd128PutChar( LCD128 *lcd, unsigned char character, int byte );
 
 void lcd128Puts( LCD128 *lcd, const char* string, int byte );
@@ -0,0 +1,82 @@
+/*
+ * lcdBus.h:
+ *  Scheduler for several HD44780/ST7920 lcds sharing RS and DB0-DB7
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __LCD_BUS_H__
+#define __LCD_BUS_H__
+
+#include <stdint.h>
+
+#include "jakestering.h"
+#include "lcd.h"
+#include "lcd128x64.h"
+
+#define LCD_BUS_DISPLAYS 8
+#define LCD_BUS_QUEUE    512 //writes held per display, must be a power of two
+
+typedef struct _lcdBusWrite
+{
+  int value;     // RS in bit 8, byte in bits 0-7
+  int execNanos; // controller busy time after the write
+} LcdBusWrite;
+
+typedef struct _lcdBusDisplay
+{
+  int E;
+  const BusTiming *timing; // the device's own, so later calibration applies
+  uint64_t readyAt;        // ns when the controller takes its next write
+  LcdBusWrite writes[ LCD_BUS_QUEUE ];
+  unsigned int head;
+  unsigned int tail;
+} LcdBusDisplay;
+
+/*
+ * Owns RS and DB0-DB7 for every display on it. Writes are queued per
+ * display and lcdBusRun sends them, filling the time one controller is
+ * busy with writes to the others.
+ */
+
+typedef struct _lcdBus
+{
+  int RS;
+  int DB0; // DB0-DB7 on 8 consecutive pins
+  int rs;  // level RS was left at
+  LcdBusDisplay displays[ LCD_BUS_DISPLAYS ];
+  int count;
+  int next; // round robin start
+} LcdBus;
+
+LcdBus* initLcdBus( int RS, int DB0 );
+
+int lcdBusAddLcd( LcdBus *bus, LCD *lcd );
+
+int lcdBusAddLcd128( LcdBus *bus, LCD128 *lcd );
+
+void lcdBusQueue( LcdBus *bus, int slot, int rs, int data, int execNanos );
+
+int lcdBusPending( LcdBus *bus );
+
+int lcdBusRun( LcdBus *bus );
+
+#endif
+
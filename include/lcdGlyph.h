@@ -0,0 +1,66 @@
+/*
+ * lcdGlyph.h:
+ *  CGRAM glyph manager and pseudo-graphics canvas for HD44780 lcd driver
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __LCD_GLYPH_H__
+#define __LCD_GLYPH_H__
+
+#include <stdint.h>
+
+#include "lcd.h"
+
+#define LCD_GLYPH_WIDTH  5
+#define LCD_GLYPH_HEIGHT 8
+
+#define LCD_CANVAS_MAX_CELLS LCD_GLYPH_SLOTS
+
+#define LCD_FULL_BLOCK 0xFF //ROM character with every pixel set
+
+/*
+ * Small bitmap drawn with custom characters. Every cell needs its own
+ * CGRAM slot unless it is blank or full, so at most 8 cells.
+ */
+
+typedef struct _lcdCanvas
+{
+  int cellsWide;
+  int cellsHigh;
+  uint64_t cells[ LCD_CANVAS_MAX_CELLS ]; // one glyph bitmap per cell, row major
+} LcdCanvas;
+
+int lcdGlyph( LCD *lcd, const unsigned char rows[ LCD_GLYPH_HEIGHT ] );
+
+int lcdGlyphBitmap( LCD *lcd, uint64_t bitmap );
+
+int lcdCanvasInit( LcdCanvas *canvas, int cellsWide, int cellsHigh );
+
+void lcdCanvasClear( LcdCanvas *canvas );
+
+void lcdCanvasSetPixel( LcdCanvas *canvas, int x, int y, int value );
+
+int lcdCanvasDraw( LCD *lcd, LcdCanvas *canvas, int x, int y );
+
+int lcdBarGraph( LCD *lcd, int x, int y, int width, int value, int max );
+
+#endif
+
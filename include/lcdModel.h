@@ -0,0 +1,124 @@
+/*
+ * lcdModel.h:
+ *  Behavioural HD44780 model for checking bus timing against the datasheet
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __LCD_MODEL_H__
+#define __LCD_MODEL_H__
+
+#include <stdint.h>
+
+#include "jakestering.h"
+
+/*
+ * Datasheet minimums in nano seconds
+ *  tAS   : RS/RW setup before E rises
+ *  PWEH  : E high pulse width
+ *  tH    : RS/RW/data hold after E falls
+ *  tDSW  : data setup before E falls
+ *  tcycE : E cycle time
+ *  exec  : instruction and data write execution
+ */
+
+#define LCD_T_AS         40
+#define LCD_T_PWEH       230
+#define LCD_T_H          10
+#define LCD_T_DSW        80
+#define LCD_T_CYCE       500
+#define LCD_T_EXEC       37000
+#define LCD_T_EXEC_HOME  1520000
+
+#define LCD_VIOLATION_TAS   0
+#define LCD_VIOLATION_PWEH  1
+#define LCD_VIOLATION_TH    2
+#define LCD_VIOLATION_TDSW  3
+#define LCD_VIOLATION_TCYCE 4
+#define LCD_VIOLATION_EXEC  5
+#define LCD_VIOLATION_KINDS 6
+
+#define LCD_MODEL_KEEP 16 //violations kept with their details
+
+typedef struct _lcdTiming
+{
+  int tAS;
+  int PWEH;
+  int tH;
+  int tDSW;
+  int tcycE;
+  int exec;
+  int execHome;
+} LcdTiming;
+
+typedef struct _lcdViolation
+{
+  int index;    // bus log entry where it was seen
+  int kind;     // LCD_VIOLATION_*
+  int actual;   // ns measured
+  int required; // ns needed
+} LcdViolation;
+
+/*
+ * Rebuilds what an 8-bit HD44780 on the given pins would hold after
+ * seeing the logged writes, and counts every timing rule they break.
+ */
+
+typedef struct _lcdModel
+{
+  int RS;
+  int RW;  // -1 when tied to ground
+  int E;
+  int DB0; // DB0-DB7 on 8 consecutive pins
+  LcdTiming timing;
+
+  unsigned char ddram[ 128 ];
+  unsigned char cgram[ 64 ];
+  int address;
+  int cgramMode;
+  int increment;
+  int shiftOnWrite; // entry mode S, each DDRAM write shifts the display
+  int shift;
+  int control;
+  int function;
+
+  uint32_t levels;
+  uint64_t addressChanged; // last RS/RW change
+  uint64_t dataChanged;    // last DB0-DB7 change
+  uint64_t rise;           // last E rising edge
+  uint64_t fall;           // last E falling edge
+  uint64_t busyUntil;      // end of the running instruction
+
+  int writes;              // bytes latched
+  int counts[ LCD_VIOLATION_KINDS ];
+  LcdViolation kept[ LCD_MODEL_KEEP ];
+  int keptCount;
+} LcdModel;
+
+LcdModel* initLcdModel( int RS, int RW, int E, int DB0 );
+
+int lcdModelRun( LcdModel *model, const BusLog *log );
+
+int lcdModelViolations( LcdModel *model );
+
+void lcdModelReport( LcdModel *model );
+
+#endif
+
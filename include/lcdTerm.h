@@ -0,0 +1,86 @@
+/*
+ * lcdTerm.h:
+ *  VT100/ANSI terminal emulator for HD44780 lcd driver
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#ifndef __LCD_TERM_H__
+#define __LCD_TERM_H__
+
+#include "lcd.h"
+
+#define LCD_TERM_SCROLLBACK 64 //lines kept after they scroll off the top
+#define LCD_TERM_LINES      ( LCD_TERM_SCROLLBACK + LCD_MAX_ROWS )
+#define LCD_TERM_PARAMS     4  //numeric parameters kept per escape sequence
+#define LCD_TERM_TAB        8
+
+/*
+ * Terminal grid. Lines live in a ring so scrolling moves an index instead
+ * of copying, and the lines above the screen are the scrollback. Output
+ * reaches the lcd through the virtual screen, so only changed cells are
+ * sent and a scroll costs only the cells that differ from the line above.
+ */
+
+typedef struct _lcdTerm
+{
+  LCD *lcd;
+  int rows;
+  int cols;
+  int cx;
+  int cy;
+  int savedX;
+  int savedY;
+  int wrapPending; // last column was written, wrap on the next char
+  int cursor;      // cursor shown
+
+  unsigned char lines[ LCD_TERM_LINES ][ LCD_MAX_COLS ];
+  int top;         // ring index of the first row on screen
+  int stored;      // scrollback lines held
+  int view;        // lines scrolled back into view, 0 = live
+
+  unsigned char shown[ LCD_MAX_ROWS ][ LCD_MAX_COLS ]; // last grid handed to the lcd
+
+  int state;       // escape parser state
+  int params[ LCD_TERM_PARAMS ];
+  int paramCount;
+  int privateMode; // '?' seen after CSI
+} LcdTerm;
+
+LcdTerm* initLcdTerm( LCD *lcd );
+
+void lcdTermPutChar( LcdTerm *term, unsigned char character );
+
+int lcdTermWrite( LcdTerm *term, const char *buffer, int length );
+
+int lcdTermPuts( LcdTerm *term, const char *string );
+
+int lcdTermPrintf( LcdTerm *term, const char *string, ... );
+
+void lcdTermScroll( LcdTerm *term, int lines );
+
+void lcdTermView( LcdTerm *term, int linesBack );
+
+int lcdTermRender( LcdTerm *term );
+
+int lcdTermRun( LcdTerm *term, int fd );
+
+#endif
+
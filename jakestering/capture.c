@@ -0,0 +1,388 @@
+/*
+ * capture.c:
+ *  Logic analyzer capture of the GPIO level register
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "capture.h"
+#include "jakestering.h"
+
+/*
+ * Append a record to the ring and check it against the trigger
+ *
+ * Parameters:
+ *  cap   : capture to append to
+ *  delta : samples since the previous record
+ *  levels: masked levels
+ *
+ * Return:
+ *  1 once enough records follow the trigger to stop, otherwise 0
+ **************************************************************
+ */
+
+static int capture_record( Capture *cap, uint32_t delta, uint32_t levels )
+{
+  CaptureRecord *record = &cap->records[ cap->head & ( cap->size - 1 ) ];
+
+  record->delta = delta;
+  record->levels = levels;
+  __atomic_store_n( &cap->head, cap->head + 1, __ATOMIC_RELEASE );
+
+  if ( !cap->triggered && ( levels & cap->triggerMask ) == cap->triggerValue )
+  {
+    cap->triggered = 1;
+    cap->triggerIndex = cap->head - 1;
+  }
+
+  return cap->triggered && ( cap->head - 1 - cap->triggerIndex ) >= cap->postRecords;
+}
+
+/*
+ * Sampler thread. Reads GPLEV0 as fast as the bus allows and stores only
+ * the samples where a captured pin changed.
+ *
+ * Parameters:
+ *  arg: the Capture
+ *
+ * Return:
+ *  NULL
+ **************************************************************
+ */
+
+static void *capture_thread( void *arg )
+{
+  Capture *cap = ( Capture* )arg;
+  uint32_t mask = cap->pinMask;
+  uint32_t last, levels, delta = 0;
+  uint64_t samples = 0;
+
+  if ( cap->priority > 0 )
+  {
+    (void)piHiPri( cap->priority ); //starves everything else on a single core board until the capture ends
+  }
+
+  cap->startNs = micros() * 1000;
+
+  last = GPIO_LEV0 & mask;
+  int done = capture_record( cap, 0, last );
+
+  while ( cap->running && !done )
+  {
+    levels = GPIO_LEV0 & mask;
+    delta++;
+
+    if ( levels != last || delta == UINT32_MAX )
+    {
+      samples += delta;
+      done = capture_record( cap, delta, levels );
+      last = levels;
+      delta = 0;
+    }
+  }
+
+  cap->samples = samples + delta;
+  cap->stopNs = micros() * 1000;
+  cap->running = 0;
+
+  return NULL;
+}
+
+/*
+ * Create a capture. setupIO must have been called.
+ *
+ * Parameters:
+ *  records: ring size in records, rounded up to a power of two
+ *  pinMask: pins to record, bit n = GPIO n
+ *  cpu    : core to pin the sampler to, -1 to leave it unpinned
+ *
+ * Return:
+ *  Capture that has been initialized, NULL on failure
+ **************************************************************
+ */
+
+Capture *initCapture( size_t records, uint32_t pinMask, int cpu )
+{
+  Capture *cap = ( Capture* )calloc( 1, sizeof( Capture ) );
+  size_t size = 1;
+
+  if ( cap == NULL )
+  {
+    printf( "Failed: to allocate capture\n" );
+    return NULL;
+  }
+
+  while ( size < records )
+  {
+    size <<= 1;
+  }
+
+  cap->records = ( CaptureRecord* )malloc( size * sizeof( CaptureRecord ) );
+  if ( cap->records == NULL )
+  {
+    printf( "Failed: could not allocate %zu capture records\n", size );
+    free( cap );
+    return NULL;
+  }
+
+  cap->size = size;
+  cap->pinMask = pinMask;
+  cap->cpu = cpu;
+  cap->postRecords = size - 1; //free running until the ring is full
+
+  return cap;
+}
+
+/*
+ * Arm a trigger. Records before the trigger stay in the ring as history,
+ * the capture stops once postRecords more have been taken.
+ *
+ * Parameters:
+ *  cap        : capture to arm
+ *  mask       : pins the pattern looks at, 0 triggers immediately
+ *  value      : levels those pins must have
+ *  postRecords: records to keep after the trigger
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void captureTrigger( Capture *cap, uint32_t mask, uint32_t value, size_t postRecords )
+{
+  cap->triggerMask = mask;
+  cap->triggerValue = value & mask;
+  cap->postRecords = MIN( postRecords, cap->size - 1 );
+}
+
+/*
+ * Start sampling on a real-time thread. A capture started before has to
+ * be waited on or stopped first, so its thread is joined.
+ *
+ * Parameters:
+ *  cap: capture to start
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int captureStart( Capture *cap )
+{
+  pthread_attr_t attr;
+
+  if ( cap->joinable )
+  {
+    printf( "Failed: capture already started, wait on or stop it first\n" );
+    return -1;
+  }
+
+  cap->head = 0;
+  cap->samples = 0;
+  cap->triggered = 0;
+  cap->running = 1;
+
+  pthread_attr_init( &attr );
+
+  if ( cap->cpu >= 0 )
+  {
+    cpu_set_t cpus;
+
+    CPU_ZERO( &cpus );
+    CPU_SET( cap->cpu, &cpus );
+    pthread_attr_setaffinity_np( &attr, sizeof( cpus ), &cpus );
+  }
+
+  if ( pthread_create( &cap->thread, &attr, capture_thread, cap ) != 0 )
+  {
+    printf( "Failed to create capture thread\n" );
+    pthread_attr_destroy( &attr );
+    cap->running = 0;
+    return -1;
+  }
+
+  pthread_attr_destroy( &attr );
+  cap->joinable = 1;
+
+  return 0;
+}
+
+/*
+ * Block until the trigger has fired and the post trigger records are in.
+ * Returns at once if the sampler has already been waited on or stopped.
+ *
+ * Parameters:
+ *  cap: capture to wait on
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void captureWait( Capture *cap )
+{
+  if ( cap->joinable )
+  {
+    pthread_join( cap->thread, NULL );
+    cap->joinable = 0;
+  }
+}
+
+/*
+ * Stop sampling early
+ *
+ * Parameters:
+ *  cap: capture to stop
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void captureStop( Capture *cap )
+{
+  cap->running = 0;
+  captureWait( cap );
+}
+
+/*
+ * Average time between samples of the last capture
+ *
+ * Parameters:
+ *  cap: finished capture
+ *
+ * Return:
+ *  sample period in nanoseconds
+ **************************************************************
+ */
+
+double captureSamplePeriod( Capture *cap )
+{
+  if ( cap->samples == 0 )
+  {
+    return 0.0;
+  }
+
+  return ( double )( cap->stopNs - cap->startNs ) / ( double )cap->samples;
+}
+
+/*
+ * Write the records held in the ring as a VCD file. Time zero is the
+ * oldest record still in the ring.
+ *
+ * Parameters:
+ *  cap : finished capture
+ *  path: file to write
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int captureExportVcd( Capture *cap, const char *path )
+{
+  FILE *file = fopen( path, "w" );
+  double period = captureSamplePeriod( cap );
+  uint64_t first = cap->head > cap->size ? cap->head - cap->size : 0;
+  uint64_t sample = 0;
+  uint32_t last = 0;
+
+  if ( file == NULL )
+  {
+    printf( "Failed: could not open %s\n", path );
+    return -1;
+  }
+
+  fprintf( file, "$timescale 1ns $end\n$scope module jakestering $end\n" );
+
+  for ( int pin = 0; pin < 32; pin++ )
+  {
+    if ( cap->pinMask & ( 1u << pin ) )
+    {
+      fprintf( file, "$var wire 1 %c gpio%d $end\n", '!' + pin, pin );
+    }
+  }
+
+  fprintf( file, "$upscope $end\n$enddefinitions $end\n" );
+
+  for ( uint64_t i = first; i < cap->head; i++ )
+  {
+    CaptureRecord *record = &cap->records[ i & ( cap->size - 1 ) ];
+    uint32_t changed = ( i == first ) ? cap->pinMask : ( record->levels ^ last );
+
+    if ( i != first )
+    {
+      sample += record->delta;
+    }
+
+    fprintf( file, "#%llu\n", ( unsigned long long )( sample * period ) );
+
+    if ( i == first )
+    {
+      fprintf( file, "$dumpvars\n" );
+    }
+
+    for ( int pin = 0; pin < 32; pin++ )
+    {
+      if ( changed & ( 1u << pin ) )
+      {
+        fprintf( file, "%d%c\n", ( record->levels >> pin ) & 1, '!' + pin );
+      }
+    }
+
+    if ( i == first )
+    {
+      fprintf( file, "$end\n" );
+    }
+
+    last = record->levels;
+  }
+
+  fclose( file );
+
+  return 0;
+}
+
+/*
+ * Free a capture and its ring
+ *
+ * Parameters:
+ *  cap: capture that is not running
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void freeCapture( Capture *cap )
+{
+  free( cap->records );
+  free( cap );
+}
+
@@ -0,0 +1,423 @@
+/*
+ * debounce.c:
+ *  Non-blocking debounce and glitch filter for buttons and switches
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "debounce.h"
+#include "jakestering.h"
+
+#define DEBOUNCE_TABLE_SIZE ( DEBOUNCE_MAX_INPUTS * 2 )
+
+/*
+ * Find the slot in the key table for a key
+ *
+ * Parameters:
+ *  db : debouncer holding the table
+ *  key: key to look up
+ *
+ * Return:
+ *  table slot holding the key, or the empty slot it would go in
+ **************************************************************
+ */
+
+static int find_slot( Debouncer *db, int key )
+{
+  uint32_t slot = ( ( uint32_t )key * 2654435761u ) % DEBOUNCE_TABLE_SIZE;
+
+  while ( db->table[ slot ] && db->inputs[ db->table[ slot ] - 1 ].key != key )
+  {
+    slot = ( slot + 1 ) % DEBOUNCE_TABLE_SIZE;
+  }
+
+  return slot;
+}
+
+/*
+ * Take a timer off the wheel
+ *
+ * Parameters:
+ *  db   : debouncer owning the wheel
+ *  timer: timer to cancel, may already be idle
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void timer_cancel( Debouncer *db, DebounceTimer *timer )
+{
+  if ( timer->slot < 0 )
+  {
+    return;
+  }
+
+  if ( timer->prev )
+  {
+    timer->prev->next = timer->next;
+  }
+
+  else
+  {
+    db->wheel[ timer->slot ] = timer->next;
+  }
+
+  if ( timer->next )
+  {
+    timer->next->prev = timer->prev;
+  }
+
+  timer->next = NULL;
+  timer->prev = NULL;
+  timer->slot = -1;
+}
+
+/*
+ * Put a timer on the wheel, replacing any earlier deadline. Timers further
+ * out than one turn of the wheel stay in their slot and are skipped until
+ * their turn comes around. Deadlines at or before the tick being processed
+ * go in the next slot.
+ *
+ * Parameters:
+ *  db     : debouncer owning the wheel
+ *  timer  : timer to schedule
+ *  expires: deadline in milli seconds
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void timer_schedule( Debouncer *db, DebounceTimer *timer, uint64_t expires )
+{
+  timer_cancel( db, timer );
+
+  if ( expires <= db->tick )
+  {
+    expires = db->tick + 1;
+  }
+
+  timer->expires = expires;
+  timer->slot = expires & ( DEBOUNCE_WHEEL_SLOTS - 1 );
+  timer->prev = NULL;
+  timer->next = db->wheel[ timer->slot ];
+
+  if ( timer->next )
+  {
+    timer->next->prev = timer;
+  }
+
+  db->wheel[ timer->slot ] = timer;
+}
+
+/*
+ * Settle timer expired: the raw level has held long enough to be accepted
+ *
+ * Parameters:
+ *  db   : debouncer owning the input
+ *  input: input whose settle timer fired
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void settle_expired( Debouncer *db, DebounceInput *input )
+{
+  if ( input->raw == input->stable )
+  {
+    return;
+  }
+
+  input->stable = input->raw;
+
+  if ( input->stable == input->activeLevel )
+  {
+    input->repeating = 0;
+
+    if ( input->longPressMs > 0 )
+    {
+      timer_schedule( db, &input->hold, input->settle.expires + input->longPressMs );
+    }
+
+    input->function( input->key, DEBOUNCE_PRESS );
+  }
+
+  else
+  {
+    timer_cancel( db, &input->hold );
+    input->function( input->key, DEBOUNCE_RELEASE );
+  }
+}
+
+/*
+ * Hold timer expired: report a long press, then keep repeating
+ *
+ * Parameters:
+ *  db   : debouncer owning the input
+ *  input: input whose hold timer fired
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void hold_expired( Debouncer *db, DebounceInput *input )
+{
+  int event = input->repeating ? DEBOUNCE_REPEAT : DEBOUNCE_LONG_PRESS;
+
+  if ( input->stable != input->activeLevel )
+  {
+    return; //released in the same tick
+  }
+
+  input->repeating = 1;
+
+  if ( input->repeatMs > 0 )
+  {
+    timer_schedule( db, &input->hold, input->hold.expires + input->repeatMs );
+  }
+
+  input->function( input->key, event );
+}
+
+/*
+ * Create a debouncer with an empty timer wheel
+ *
+ * Parameters:
+ *  nowMs: current time in milli seconds, usually millis()
+ *
+ * Return:
+ *  Debouncer that has been initialized, NULL on failure
+ **************************************************************
+ */
+
+Debouncer *initDebouncer( uint64_t nowMs )
+{
+  Debouncer *db = ( Debouncer* )calloc( 1, sizeof( Debouncer ) );
+
+  if ( db == NULL )
+  {
+    printf( "Failed: to allocate debouncer\n" );
+    return NULL;
+  }
+
+  db->tick = nowMs;
+
+  return db;
+}
+
+/*
+ * Start debouncing an input
+ *
+ * Parameters:
+ *  db         : debouncer to add to
+ *  key        : pin number or any id the caller chooses
+ *  activeLevel: HIGH/LOW level that counts as pressed
+ *  settleMs   : time the raw level must hold before it is accepted
+ *  minPulseMs : pulses narrower than this are dropped as glitches
+ *  longPressMs: hold time before LONG_PRESS, 0 to disable
+ *  repeatMs   : REPEAT period after a long press, 0 to disable
+ *  function   : called with the key and a DEBOUNCE_* event
+ *
+ * Return:
+ *  0 on success, -1 if the key is taken or the debouncer is full
+ **************************************************************
+ */
+
+int debounceAdd( Debouncer *db, int key, int activeLevel, int settleMs, int minPulseMs, int longPressMs, int repeatMs, void (*function)( int key, int event ) )
+{
+  if ( db->count == DEBOUNCE_MAX_INPUTS )
+  {
+    return -1;
+  }
+
+  int slot = find_slot( db, key );
+  if ( db->table[ slot ] )
+  {
+    return -1;
+  }
+
+  DebounceInput *input = &db->inputs[ db->count ];
+
+  memset( input, 0, sizeof( DebounceInput ) );
+  input->key = key;
+  input->activeLevel = activeLevel;
+  input->settleMs = settleMs;
+  input->minPulseMs = minPulseMs;
+  input->longPressMs = longPressMs;
+  input->repeatMs = repeatMs;
+  input->raw = !activeLevel;
+  input->stable = !activeLevel;
+  input->settle.slot = -1;
+  input->settle.input = db->count;
+  input->hold.slot = -1;
+  input->hold.input = db->count;
+  input->hold.hold = 1;
+  input->function = function;
+
+  db->table[ slot ] = ++db->count;
+
+  return 0;
+}
+
+/*
+ * Feed the raw level of an input. Call it from an edge callback or from a
+ * polling loop; unchanged levels are ignored, so sampling is cheap.
+ *
+ * Parameters:
+ *  db   : debouncer owning the input
+ *  key  : key given to debounceAdd
+ *  level: raw HIGH/LOW level
+ *  nowMs: time the level was seen in milli seconds
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void debounceUpdate( Debouncer *db, int key, int level, uint64_t nowMs )
+{
+  int slot = find_slot( db, key );
+  if ( !db->table[ slot ] )
+  {
+    return;
+  }
+
+  DebounceInput *input = &db->inputs[ db->table[ slot ] - 1 ];
+
+  level = level ? HIGH : LOW;
+  if ( level == input->raw )
+  {
+    return;
+  }
+
+  input->raw = level;
+
+  if ( input->minPulseMs > 0 && nowMs - input->lastEdge < ( uint64_t )input->minPulseMs )
+  {
+    input->lastEdge = input->prevEdge; //glitch, forget both of its edges
+  }
+
+  else
+  {
+    input->prevEdge = input->lastEdge;
+    input->lastEdge = nowMs;
+  }
+
+  if ( input->raw == input->stable )
+  {
+    timer_cancel( db, &input->settle );
+    return;
+  }
+
+  timer_schedule( db, &input->settle, input->lastEdge + input->settleMs );
+}
+
+/*
+ * Advance the timer wheel and fire every timer that has expired, in
+ * deadline order. Each millisecond up to nowMs is visited, except that
+ * gaps longer than a turn of the wheel jump to the next deadline, so the
+ * cost follows the time passed or the number of expired timers rather
+ * than the number of inputs.
+ *
+ * Parameters:
+ *  db   : debouncer to advance
+ *  nowMs: current time in milli seconds
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void debounceTick( Debouncer *db, uint64_t nowMs )
+{
+  if ( nowMs <= db->tick )
+  {
+    return;
+  }
+
+  while ( db->tick < nowMs )
+  {
+    if ( nowMs - db->tick > DEBOUNCE_WHEEL_SLOTS ) //long gap, jump to the next deadline instead of walking empty turns
+    {
+      uint64_t deadline = nowMs;
+
+      for ( int i = 0; i < db->count; i++ )
+      {
+        if ( db->inputs[ i ].settle.slot >= 0 )
+        {
+          deadline = MIN( deadline, db->inputs[ i ].settle.expires );
+        }
+
+        if ( db->inputs[ i ].hold.slot >= 0 )
+        {
+          deadline = MIN( deadline, db->inputs[ i ].hold.expires );
+        }
+      }
+
+      db->tick = MAX( db->tick, deadline - 1 );
+    }
+
+    int slot = ++db->tick & ( DEBOUNCE_WHEEL_SLOTS - 1 ); //callbacks reschedule against the tick being processed, never into a passed slot
+    DebounceTimer *expired = NULL;
+    DebounceTimer **last = &expired;
+
+    for ( DebounceTimer *timer = db->wheel[ slot ], *next; timer; timer = next )
+    {
+      next = timer->next;
+
+      if ( timer->expires <= db->tick )
+      {
+        timer_cancel( db, timer );
+        timer->fire = NULL;
+        *last = timer;
+        last = &timer->fire;
+      }
+    }
+
+    for ( DebounceTimer *timer = expired; timer; timer = timer->fire )
+    {
+      if ( timer->slot >= 0 )
+      {
+        continue; //rescheduled by an earlier callback
+      }
+
+      DebounceInput *input = &db->inputs[ timer->input ];
+
+      if ( timer->hold )
+      {
+        hold_expired( db, input );
+      }
+
+      else
+      {
+        settle_expired( db, input );
+      }
+    }
+  }
+}
+
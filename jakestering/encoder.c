@@ -0,0 +1,243 @@
+/*
+ * encoder.c:
+ *  Quadrature rotary encoder decoder
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "encoder.h"
+#include "jakestering.h"
+
+/*
+ * Step for every ( previous << 2 | current ) AB state pair. Pairs where both
+ * phases changed at once are invalid and count as 0; with both phases on
+ * one line request every event changes a single phase, so they never occur.
+ */
+
+static const int8_t transitionTable[ 16 ] =
+{
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0,
+};
+
+/*
+ * Edge handler shared by both phases. Both are requested as one line, so
+ * edges arrive in the order they happened and the AB state is kept from
+ * the events alone: each edge sets its own phase's bit. An edge that
+ * leaves its phase where it already was means the opposite edge was lost.
+ * The state is swapped with a CAS so each transition is consumed once.
+ *
+ * Parameters:
+ *  pin      : phase that changed
+ *  edge     : RISING_EDGE/FALLING_EDGE
+ *  timestamp: kernel timestamp of the edge in ns
+ *  arg      : the Encoder
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void encoder_event( int pin, int edge, uint64_t timestamp, void *arg )
+{
+  Encoder *enc = ( Encoder* )arg;
+  int bit = ( pin == enc->A ) ? 0b10 : 0b01;
+  int previous = __atomic_load_n( &enc->state, __ATOMIC_RELAXED );
+  int current;
+
+  do
+  {
+    current = ( edge == RISING_EDGE ) ? ( previous | bit ) : ( previous & ~bit );
+
+    if ( current == previous )
+    {
+      __atomic_fetch_add( &enc->errors, 1, __ATOMIC_RELAXED );
+      return;
+    }
+  } while ( !__atomic_compare_exchange_n( &enc->state, &previous, current, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED ) );
+
+  int step = transitionTable[ ( previous << 2 ) | current ];
+
+  __atomic_fetch_add( &enc->position, step, __ATOMIC_RELAXED );
+
+  uint64_t last = __atomic_exchange_n( &enc->lastTimestamp, timestamp, __ATOMIC_RELAXED );
+  if ( last == 0 || timestamp <= last )
+  {
+    return;
+  }
+
+  int64_t period = ( int64_t )MIN( timestamp - last, ( uint64_t )ENCODER_IDLE_NS ) * step;
+  int64_t smoothed = __atomic_load_n( &enc->periodNs, __ATOMIC_RELAXED );
+
+  if ( smoothed == 0 || ( smoothed < 0 ) != ( period < 0 ) )
+  {
+    smoothed = period; //first step or change of direction
+  }
+
+  else
+  {
+    smoothed += ( period - smoothed ) / 4;
+  }
+
+  __atomic_store_n( &enc->periodNs, smoothed, __ATOMIC_RELAXED );
+}
+
+/*
+ * Initialize a quadrature encoder on two pins. Both phases are watched on
+ * both edges as one line request through jakesteringPollEventLines, so
+ * steps are counted in edge order from jakesteringDispatchPending or
+ * gpioUringDispatch.
+ *
+ * Parameters:
+ *  A: phase A pin
+ *  B: phase B pin
+ *
+ * Return:
+ *  Encoder that has been initialized, NULL on failure
+ **************************************************************
+ */
+
+Encoder *initEncoder( int A, int B )
+{
+  const int pins[ 2 ] = { A, B };
+  Encoder *enc = ( Encoder* )calloc( 1, sizeof( Encoder ) );
+
+  if ( enc == NULL )
+  {
+    printf( "Failed: to allocate encoder\n" );
+    return NULL;
+  }
+
+  enc->A = A;
+  enc->B = B;
+
+  pinMode( enc->A, INPUT );
+  pinMode( enc->B, INPUT );
+  pudController( enc->A, PUD_UP );
+  pudController( enc->B, PUD_UP );
+
+  enc->state = ( digitalRead( enc->A ) << 1 ) | digitalRead( enc->B );
+
+  if ( jakesteringPollEventLines( pins, 2, BOTH_EDGE, encoder_event, enc ) < 0 )
+  {
+    free( enc );
+    return NULL;
+  }
+
+  return enc;
+}
+
+/*
+ * Stop watching the encoder pins and free it
+ *
+ * Parameters:
+ *  enc: encoder to close
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void closeEncoder( Encoder *enc )
+{
+  jakesteringPollClose( enc->A ); //releases B with it
+  free( enc );
+}
+
+/*
+ * Read the encoder position
+ *
+ * Parameters:
+ *  enc: encoder to read
+ *
+ * Return:
+ *  position in steps, 4 per quadrature cycle
+ **************************************************************
+ */
+
+int64_t encoderPosition( Encoder *enc )
+{
+  return __atomic_load_n( &enc->position, __ATOMIC_RELAXED );
+}
+
+/*
+ * Overwrite the encoder position, e.g. to zero it at a home switch
+ *
+ * Parameters:
+ *  enc     : encoder to set
+ *  position: new position in steps
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void encoderSetPosition( Encoder *enc, int64_t position )
+{
+  __atomic_store_n( &enc->position, position, __ATOMIC_RELAXED );
+}
+
+/*
+ * Estimate the encoder velocity from the edge timestamps, which a line
+ * request stamps with CLOCK_MONOTONIC like nanos
+ *
+ * Parameters:
+ *  enc: encoder to read
+ *
+ * Return:
+ *  steps per second, negative when turning backwards, 0 when idle
+ **************************************************************
+ */
+
+double encoderVelocity( Encoder *enc )
+{
+  int64_t period = __atomic_load_n( &enc->periodNs, __ATOMIC_RELAXED );
+  uint64_t last = __atomic_load_n( &enc->lastTimestamp, __ATOMIC_RELAXED );
+
+  if ( period == 0 || nanos() - last > ENCODER_IDLE_NS )
+  {
+    return 0.0;
+  }
+
+  return 1e9 / ( double )period;
+}
+
+/*
+ * Count of invalid edges seen, a sign of missed edges or noise
+ *
+ * Parameters:
+ *  enc: encoder to read
+ *
+ * Return:
+ *  number of edges that left their phase at the level it already had
+ **************************************************************
+ */
+
+uint32_t encoderErrors( Encoder *enc )
+{
+  return __atomic_load_n( &enc->errors, __ATOMIC_RELAXED );
+}
+
@@ -0,0 +1,596 @@
+/*
+ * gpioUring.c:
+ *  io_uring backend for GPIO edge event ingestion
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/gpio.h>
+#include <linux/io_uring.h>
+
+#undef BLOCK_SIZE //linux/fs.h defines its own, jakestering.h's is the one used here
+
+#include "jakestering.h"
+#include "gpioUring.h"
+
+#define URING_EVENTS   16           //line request events reaped per completed read, 48 for a single line
+#define URING_POLL_TAG   ( 1u << 8 ) //user_data tag for the poll half of a linked pair
+#define URING_CANCEL_TAG ( 1u << 9 ) //user_data tag for a cancel request
+
+typedef struct _uring
+{
+  int fd;
+
+  unsigned *sqHead;
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+  unsigned sqEntries;
+
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+
+  void *sqMap;
+  void *cqMap;
+  size_t sqMapSize;
+  size_t cqMapSize;
+  size_t sqesSize;
+
+  unsigned pending;   //SQEs queued but not yet submitted
+} Uring;
+
+static Uring ring = { .fd = -1 };
+
+static struct gpio_v2_line_event uring_events[32][URING_EVENTS];
+static uint32_t armed_pins = 0;   //pins with a read in flight
+
+#ifdef __NR_io_uring_setup
+
+/*
+ * Grab the next free submission queue entry
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  zeroed sqe, NULL if the submission queue is full
+ **************************************************************
+ */
+
+static struct io_uring_sqe *uring_get_sqe( void )
+{
+  unsigned tail = *ring.sqTail + ring.pending;
+  unsigned head = __atomic_load_n( ring.sqHead, __ATOMIC_ACQUIRE );
+
+  if ( tail - head >= ring.sqEntries )
+  {
+    return NULL;
+  }
+
+  unsigned index = tail & *ring.sqMask;
+  struct io_uring_sqe *sqe = &ring.sqes[index];
+
+  memset( sqe, 0, sizeof( *sqe ) );
+  ring.sqArray[index] = index;
+  ring.pending++;
+
+  return sqe;
+}
+
+/*
+ * Publish queued SQEs and optionally wait for a completion
+ *
+ * Parameters:
+ *  wait: 1 = block until at least one completion | 0 = return immediately
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+static int uring_enter( const int wait )
+{
+  unsigned submit = ring.pending;
+
+  if ( submit == 0 && !wait )
+  {
+    return 0;
+  }
+
+  __atomic_store_n( ring.sqTail, *ring.sqTail + submit, __ATOMIC_RELEASE );
+  ring.pending = 0;
+
+  int ret = syscall( __NR_io_uring_enter, ring.fd, submit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+  if ( ret < 0 && errno != EINTR )
+  {
+    printf( "Failed: io_uring_enter returned %d\n", ret );
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Queue a poll linked to a batched read on a pin's line fd. The read only
+ * runs once the fd is readable, so the non-blocking fd never returns EAGAIN
+ * to the ring. Pins that already have a read in flight are left alone.
+ *
+ * Parameters:
+ *  pin: GPIO pin to arm
+ *
+ * Return:
+ *  0 on success, -1 if the pin has no fd or the ring is full
+ **************************************************************
+ */
+
+static int uring_arm( const int pin )
+{
+  int fd = jakesteringLineFd( pin );
+  struct io_uring_sqe *poll, *read;
+
+  if ( fd < 0 )
+  {
+    return -1;
+  }
+
+  if ( armed_pins & ( 1u << pin ) )
+  {
+    return 0; //a second read would race the first for the same buffer
+  }
+
+  if ( ring.sqEntries - ring.pending < 2 && uring_enter( 0 ) < 0 )
+  {
+    return -1;
+  }
+
+  if ( ( poll = uring_get_sqe() ) == NULL || ( read = uring_get_sqe() ) == NULL )
+  {
+    return -1;
+  }
+
+  poll->opcode = IORING_OP_POLL_ADD;
+  poll->fd = fd;
+  poll->poll32_events = POLLIN;
+  poll->flags = IOSQE_IO_LINK;
+  poll->user_data = pin | URING_POLL_TAG;
+
+  read->opcode = IORING_OP_READ;
+  read->fd = fd;
+  read->addr = ( uint64_t )( uintptr_t )uring_events[pin];
+  read->len = sizeof( uring_events[pin] );
+  read->off = ( uint64_t )-1;
+  read->user_data = pin;
+
+  armed_pins |= ( 1u << pin );
+
+  return 0;
+}
+
+/*
+ * Arm every pin registered with jakesteringPollISR that has no read in
+ * flight
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+static int uring_arm_pins( void )
+{
+  uint32_t pins = jakesteringPollPins();
+
+  for ( int pin = 0; pin < 32; pin++ )
+  {
+    if ( ( pins & ( 1u << pin ) ) && uring_arm( pin ) < 0 )
+    {
+      printf( "Failed: could not arm pin %d\n", pin );
+    }
+  }
+
+  return uring_enter( 0 );
+}
+
+/*
+ * Consume every completion queued, dispatching the events each read
+ * returned. The head is published before each dispatch, so a callback
+ * that closes a pin can reap from the same queue without seeing a
+ * completion twice.
+ *
+ * Parameters:
+ *  rearm: bit n set for every pin n whose read completed and can be armed again
+ *
+ * Return:
+ *  number of events dispatched
+ **************************************************************
+ */
+
+static int uring_reap( uint32_t *rearm )
+{
+  int dispatched = 0;
+  unsigned head;
+
+  while ( ( head = *ring.cqHead ) != __atomic_load_n( ring.cqTail, __ATOMIC_ACQUIRE ) )
+  {
+    struct io_uring_cqe *cqe = &ring.cqes[head & *ring.cqMask];
+    uint64_t tag = cqe->user_data;
+    int pin = tag & 0xff;
+    int res = cqe->res;
+
+    __atomic_store_n( ring.cqHead, head + 1, __ATOMIC_RELEASE );
+
+    if ( tag & ( URING_POLL_TAG | URING_CANCEL_TAG ) )
+    {
+      continue; //the linked read reports the outcome
+    }
+
+    armed_pins &= ~( 1u << pin );
+
+    if ( res > 0 )
+    {
+      dispatched += jakesteringDispatchRead( pin, uring_events[pin], res );
+    }
+
+    if ( res != -EBADF )
+    {
+      *rearm |= ( 1u << pin );
+    }
+  }
+
+  return dispatched;
+}
+
+/*
+ * Set up the ring and keep a read pending on every pin registered with
+ * jakesteringPollISR. Events are then reaped with gpioUringDispatch instead
+ * of jakesteringDispatchPending.
+ *
+ * Parameters:
+ *  entries: submission queue size, at least twice the number of pins
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int gpioUringInit( const unsigned entries )
+{
+  struct io_uring_params params;
+
+  if ( ring.fd >= 0 )
+  {
+    return uring_arm_pins();
+  }
+
+  memset( &params, 0, sizeof( params ) );
+
+  ring.fd = syscall( __NR_io_uring_setup, entries, &params );
+  if ( ring.fd < 0 )
+  {
+    printf( "Failed: io_uring_setup returned %d\n", ring.fd );
+    return -1;
+  }
+
+  ring.sqMapSize = params.sq_off.array + params.sq_entries * sizeof( unsigned );
+  ring.cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+
+  if ( params.features & IORING_FEAT_SINGLE_MMAP )
+  {
+    ring.sqMapSize = ring.cqMapSize = MAX( ring.sqMapSize, ring.cqMapSize );
+  }
+
+  ring.sqMap = mmap( NULL, ring.sqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING );
+  if ( ring.sqMap == MAP_FAILED )
+  {
+    printf( "Failed: mmap io_uring sq ring\n" );
+    close( ring.fd );
+    ring.fd = -1;
+    return -1;
+  }
+
+  if ( params.features & IORING_FEAT_SINGLE_MMAP )
+  {
+    ring.cqMap = ring.sqMap;
+  }
+
+  else
+  {
+    ring.cqMap = mmap( NULL, ring.cqMapSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING );
+    if ( ring.cqMap == MAP_FAILED )
+    {
+      printf( "Failed: mmap io_uring cq ring\n" );
+      munmap( ring.sqMap, ring.sqMapSize );
+      close( ring.fd );
+      ring.fd = -1;
+      return -1;
+    }
+  }
+
+  ring.sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+  ring.sqes = mmap( NULL, ring.sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ring.fd, IORING_OFF_SQES );
+  if ( ring.sqes == MAP_FAILED )
+  {
+    printf( "Failed: mmap io_uring sqes\n" );
+    gpioUringClose();
+    return -1;
+  }
+
+  ring.sqHead    = ( unsigned* )( ( char* )ring.sqMap + params.sq_off.head );
+  ring.sqTail    = ( unsigned* )( ( char* )ring.sqMap + params.sq_off.tail );
+  ring.sqMask    = ( unsigned* )( ( char* )ring.sqMap + params.sq_off.ring_mask );
+  ring.sqArray   = ( unsigned* )( ( char* )ring.sqMap + params.sq_off.array );
+  ring.sqEntries = params.sq_entries;
+
+  ring.cqHead = ( unsigned* )( ( char* )ring.cqMap + params.cq_off.head );
+  ring.cqTail = ( unsigned* )( ( char* )ring.cqMap + params.cq_off.tail );
+  ring.cqMask = ( unsigned* )( ( char* )ring.cqMap + params.cq_off.ring_mask );
+  ring.cqes   = ( struct io_uring_cqe* )( ( char* )ring.cqMap + params.cq_off.cqes );
+
+  ring.pending = 0;
+  armed_pins = 0;
+
+  return uring_arm_pins();
+}
+
+/*
+ * Arm a pin registered with jakesteringPollISR after gpioUringInit. The
+ * registration calls this itself, so it is only needed to re-arm a pin
+ * whose read failed.
+ *
+ * Parameters:
+ *  pin: GPIO pin to arm
+ *
+ * Return:
+ *  0 on success, -1 if the ring is not set up, the pin is not
+ *  registered or the ring is full
+ **************************************************************
+ */
+
+int gpioUringArm( const int pin )
+{
+  if ( ring.fd < 0 || uring_arm( pin ) < 0 )
+  {
+    return -1;
+  }
+
+  return uring_enter( 0 );
+}
+
+/*
+ * Cancel the read in flight on a pin and wait for it to complete, so its
+ * line fd can be closed without the read landing on whatever file reuses
+ * the fd. Other completions reaped while waiting are dispatched as usual.
+ *
+ * Parameters:
+ *  pin: GPIO pin to disarm
+ *
+ * Return:
+ *  0 on success or when nothing was armed, -1 on failure
+ **************************************************************
+ */
+
+int gpioUringCancel( const int pin )
+{
+  struct io_uring_sqe *poll, *read;
+  uint32_t rearm = 0;
+
+  if ( ring.fd < 0 || !( armed_pins & ( 1u << pin ) ) )
+  {
+    return 0;
+  }
+
+  if ( ring.sqEntries - ring.pending < 2 && uring_enter( 0 ) < 0 )
+  {
+    return -1;
+  }
+
+  if ( ( poll = uring_get_sqe() ) == NULL || ( read = uring_get_sqe() ) == NULL )
+  {
+    return -1;
+  }
+
+  poll->opcode = IORING_OP_ASYNC_CANCEL; //before the poll fires, the linked read is cancelled with it
+  poll->addr = pin | URING_POLL_TAG;
+  poll->user_data = pin | URING_CANCEL_TAG;
+
+  read->opcode = IORING_OP_ASYNC_CANCEL; //after, the read itself
+  read->addr = pin;
+  read->user_data = pin | URING_CANCEL_TAG;
+
+  if ( uring_enter( 0 ) < 0 )
+  {
+    return -1;
+  }
+
+  while ( armed_pins & ( 1u << pin ) )
+  {
+    if ( uring_enter( 1 ) < 0 || uring_reap( &rearm ) < 0 )
+    {
+      return -1;
+    }
+  }
+
+  rearm &= jakesteringPollPins() & ~( 1u << pin );
+  for ( int other = 0; other < 32; other++ )
+  {
+    if ( rearm & ( 1u << other ) )
+    {
+      uring_arm( other );
+    }
+  }
+
+  return uring_enter( 0 );
+}
+
+/*
+ * Get the ring fd. It is pollable, so it can sit in an existing event loop
+ * in place of jakesteringPollFd.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  ring fd, -1 if gpioUringInit has not run
+ **************************************************************
+ */
+
+int gpioUringFd( void )
+{
+  return ring.fd;
+}
+
+/*
+ * Reap every completed read from the completion queue, dispatch the events
+ * and re-arm the pins. One call handles any number of completions, each
+ * carrying up to URING_EVENTS edges.
+ *
+ * Parameters:
+ *  wait: 1 = block until at least one read completes | 0 = never block
+ *
+ * Return:
+ *  number of events dispatched, -1 on failure
+ **************************************************************
+ */
+
+int gpioUringDispatch( const int wait )
+{
+  uint32_t rearm = 0;
+  int dispatched = 0;
+
+  if ( ring.fd < 0 )
+  {
+    return -1;
+  }
+
+  if ( wait && __atomic_load_n( ring.cqTail, __ATOMIC_ACQUIRE ) == *ring.cqHead )
+  {
+    if ( uring_enter( 1 ) < 0 )
+    {
+      return -1;
+    }
+  }
+
+  dispatched = uring_reap( &rearm );
+
+  rearm &= jakesteringPollPins();
+  for ( int pin = 0; pin < 32; pin++ )
+  {
+    if ( rearm & ( 1u << pin ) )
+    {
+      uring_arm( pin );
+    }
+  }
+
+  if ( uring_enter( 0 ) < 0 )
+  {
+    return -1;
+  }
+
+  return dispatched;
+}
+
+/*
+ * Tear down the ring. Pending reads are cancelled with it.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void gpioUringClose( void )
+{
+  if ( ring.fd < 0 )
+  {
+    return;
+  }
+
+  if ( ring.sqes && ring.sqes != MAP_FAILED )
+  {
+    munmap( ring.sqes, ring.sqesSize );
+  }
+
+  if ( ring.cqMap && ring.cqMap != ring.sqMap )
+  {
+    munmap( ring.cqMap, ring.cqMapSize );
+  }
+
+  munmap( ring.sqMap, ring.sqMapSize );
+  close( ring.fd );
+
+  memset( &ring, 0, sizeof( ring ) );
+  ring.fd = -1;
+  armed_pins = 0;
+}
+
+#else
+
+int gpioUringInit( const unsigned entries )
+{
+  (void)entries;
+  printf( "Failed: io_uring is not supported on this system\n" );
+  return -1;
+}
+
+int gpioUringFd( void )
+{
+  return -1;
+}
+
+int gpioUringArm( const int pin )
+{
+  (void)pin;
+  return -1;
+}
+
+int gpioUringCancel( const int pin )
+{
+  (void)pin;
+  return 0;
+}
+
+int gpioUringDispatch( const int wait )
+{
+  (void)wait;
+  return -1;
+}
+
+void gpioUringClose( void )
+{
+}
+
+#endif
@@ -33,9 +33,13 @@
 #include <poll.h>
 #include <sys/ioctl.h>
 #include <linux/gpio.h>
+#include <sys/epoll.h>
 #include <sched.h>
+#include <time.h>
+#include <errno.h>
 
 #include "jakestering.h"
+#include "gpioUring.h"
 
 int memFd;
 void* gpioMap;
@@ -51,6 +55,15 @@ static pthread_t isr_threads[32];
 static int isr_modes[32];
 static int isr_function_called[32] = {1};
 
+static int poll_FD = -1;         //epoll set holding every line fd registered without a thread
+static uint32_t poll_pins = 0;   //pins serviced by jakesteringDispatchPending
+static void(*event_functions[32])( int pin, int edge, uint64_t timestamp, void *arg );
+static void *event_args[32];
+static uint32_t line_groups[32];   //pins a v2 line request covers, kept on its first pin
+
+static int fake_io = 0;          //gpio points at plain memory, levels are kept by hand
+static BusLog bus_log;
+
 /*
  * Sets up the GPIO memory address space to be modified
  *
@@ -83,6 +96,119 @@ void setupIO( void )
   gpio = ( volatile unsigned* )gpioMap;
 }
 
+/*
+ * Point the GPIO registers at plain memory so the library runs without
+ * /dev/mem. Output writes show up on GPLEV0 and can be logged with
+ * timestamps for checking bus timing.
+ *
+ * Parameters:
+ *  logSize: bus writes to keep, 0 for no log
+ * 
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int setupFakeIO( const int logSize )
+{
+  gpio = ( volatile unsigned* )calloc( 1, BLOCK_SIZE );
+
+  if ( gpio == NULL )
+  {
+    printf( "Failed: to allocate fake gpio registers\n" );
+    return -1;
+  }
+
+  gpioMap = ( void* )gpio;
+  fake_io = 1;
+
+  free( bus_log.writes );
+  memset( &bus_log, 0, sizeof( bus_log ) );
+
+  if ( logSize > 0 )
+  {
+    bus_log.writes = ( BusWrite* )malloc( logSize * sizeof( BusWrite ) );
+
+    if ( bus_log.writes == NULL )
+    {
+      printf( "Failed: to allocate bus log\n" );
+      return -1;
+    }
+
+    bus_log.size = logSize;
+  }
+
+  return 0;
+}
+
+/*
+ * Get the bus write log of the fake backend
+ *
+ * Parameters:
+ *  void
+ * 
+ * Return:
+ *  the log, its writes are NULL when logging is off
+ **************************************************************
+ */
+
+BusLog* jakesteringBusLog( void )
+{
+  return &bus_log;
+}
+
+/*
+ * Empty the bus write log
+ *
+ * Parameters:
+ *  void
+ * 
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void jakesteringBusLogClear( void )
+{
+  bus_log.count = 0;
+  bus_log.dropped = 0;
+}
+
+/*
+ * Apply an output write to the fake levels and log it
+ *
+ * Parameters:
+ *  set  : bits written to GPSET0
+ *  clear: bits written to GPCLR0
+ * 
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void fake_write( const uint32_t set, const uint32_t clear )
+{
+  GPIO_LEV0 = ( GPIO_LEV0 & ~clear ) | set;
+
+  if ( bus_log.writes == NULL )
+  {
+    return;
+  }
+
+  if ( bus_log.count == bus_log.size )
+  {
+    bus_log.dropped++;
+    return;
+  }
+
+  BusWrite *write = &bus_log.writes[ bus_log.count++ ];
+
+  write->nanos = nanos();
+  write->set = set;
+  write->clear = clear;
+  write->levels = GPIO_LEV0;
+}
+
 /*
  * Delay in milli seconds, but if milliSecond is higer than 1000 delay in seconds
  *
@@ -120,9 +246,108 @@ void delay( int milliSeconds )
 
 void delayMicro( int microSeconds )
 {
+  if ( microSeconds < 100 ) //usleep overshoots short waits by tens of micro seconds, spin instead
+  {
+    struct timespec now, end;
+
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    end.tv_nsec += microSeconds * 1000;
+    if ( end.tv_nsec >= 1000000000 )
+    {
+      end.tv_sec++;
+      end.tv_nsec -= 1000000000;
+    }
+
+    do
+    {
+      clock_gettime( CLOCK_MONOTONIC, &now );
+    } while ( now.tv_sec < end.tv_sec || ( now.tv_sec == end.tv_sec && now.tv_nsec < end.tv_nsec ) );
+
+    return;
+  }
+
   usleep( microSeconds );
 }
 
+/*
+ * Delay in nano seconds by spinning, for bus timing below a micro second
+ *
+ * Parameters:
+ *  nanoSeconds: amount of time to delay
+ * 
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void delayNano( int nanoSeconds )
+{
+  if ( nanoSeconds <= 0 )
+  {
+    return;
+  }
+
+  uint64_t end = nanos() + nanoSeconds;
+
+  while ( nanos() < end );
+}
+
+/*
+ * Time since an arbitrary fixed point, unaffected by wall clock changes
+ *
+ * Parameters:
+ *  void
+ * 
+ * Return:
+ *  monotonic time in nano seconds
+ **************************************************************
+ */
+
+uint64_t nanos( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+
+  return ( uint64_t )ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+ * Time since an arbitrary fixed point, unaffected by wall clock changes
+ *
+ * Parameters:
+ *  void
+ * 
+ * Return:
+ *  monotonic time in micro seconds
+ **************************************************************
+ */
+
+uint64_t micros( void )
+{
+  struct timespec ts;
+
+  clock_gettime( CLOCK_MONOTONIC, &ts );
+
+  return ( uint64_t )ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Time since an arbitrary fixed point, unaffected by wall clock changes
+ *
+ * Parameters:
+ *  void
+ * 
+ * Return:
+ *  monotonic time in milli seconds
+ **************************************************************
+ */
+
+uint64_t millis( void )
+{
+  return micros() / 1000;
+}
+
 /*
  * Pin mode sets the INPUT/OUTPUT state of a pin 
  *
@@ -195,6 +420,11 @@ void digitalWrite( const int pin, const int value )
   {
     GPIO_SET = 1 << pin;
   }
+
+  if ( fake_io )
+  {
+    fake_write( ( value == HIGH ) ? 1 << pin : 0, ( value == LOW ) ? 1 << pin : 0 );
+  }
 }
 
 /*
@@ -258,6 +488,11 @@ void digitalWriteByte( const int value, const int pinStart, const int pinEnd ) /
 
   GPIO_CLR = pinClr;
   GPIO_SET = pinSet;
+
+  if ( fake_io )
+  {
+    fake_write( pinSet, pinClr );
+  }
 }
 
 static void *interrupt_handler(void *arg)
@@ -359,10 +594,19 @@ int wait_for_interrupt_to_close( const int pin )
   return 0;
 }
 
-int interrupt_init( const int pin, const int mode )
+/*
+ * Open the gpio chip the line requests are made on, once
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+static int chip_open( void )
 {
-  const char* strmode = "";
-  sleep(1);
   const char *gpio_chip = "/dev/gpiochip0";
 
   if ( chip_FD < 0 )
@@ -375,6 +619,20 @@ int interrupt_init( const int pin, const int mode )
     }
   }
 
+  return 0;
+}
+
+int interrupt_init( const int pin, const int mode )
+{
+  const char* strmode = "";
+  sleep(1);
+  const char *gpio_chip = "/dev/gpiochip0";
+
+  if ( chip_open() < 0 )
+  {
+    return -1;
+  }
+
   struct gpioevent_request req;
   req.lineoffset = pin;
   req.handleflags = GPIOHANDLE_REQUEST_INPUT;
@@ -462,4 +720,613 @@ int piHiPri (const int pri)
   return sched_setscheduler (0, SCHED_RR, &sched) ;
 }
 
+/*
+ * Run the callback registered for a pin against one line event. Used by
+ * every zero-thread backend so they share the same callback semantics.
+ *
+ * Parameters:
+ *  pin      : GPIO pin the event came from
+ *  id       : GPIOEVENT_EVENT_RISING_EDGE/GPIOEVENT_EVENT_FALLING_EDGE
+ *  timestamp: kernel timestamp of the edge in nanoseconds
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void jakesteringDispatchEvent( const int pin, const uint32_t id, const uint64_t timestamp )
+{
+  if ( event_functions[pin] )
+  {
+    event_functions[pin]( pin, id == GPIOEVENT_EVENT_RISING_EDGE ? RISING_EDGE : FALLING_EDGE, timestamp, event_args[pin] );
+  }
+
+  if ( isr_functions[pin] )
+  {
+    isr_functions[pin]();
+  }
+}
+
+/*
+ * Dispatch the events in a buffer read from a pin's line fd. A single
+ * line holds gpioevent_data records, a line request from
+ * jakesteringPollEventLines holds gpio_v2_line_event records naming the
+ * pin each edge came from.
+ *
+ * Parameters:
+ *  pin   : GPIO pin the fd was read for
+ *  buffer: bytes read
+ *  bytes : number of bytes read
+ *
+ * Return:
+ *  number of events dispatched
+ **************************************************************
+ */
+
+int jakesteringDispatchRead( const int pin, const void *buffer, const int bytes )
+{
+  if ( line_groups[pin] == 0 )
+  {
+    const struct gpioevent_data *events = buffer;
+    int count = bytes / sizeof( events[0] );
+
+    for ( int i = 0; i < count; i++ )
+    {
+      jakesteringDispatchEvent( pin, events[i].id, events[i].timestamp );
+    }
+
+    return count;
+  }
+
+  const struct gpio_v2_line_event *events = buffer;
+  int count = bytes / sizeof( events[0] );
+
+  for ( int i = 0; i < count; i++ )
+  {
+    if ( events[i].offset < 32 && ( line_groups[pin] & ( 1u << events[i].offset ) ) )
+    {
+      uint32_t id = ( events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE ) ? GPIOEVENT_EVENT_RISING_EDGE : GPIOEVENT_EVENT_FALLING_EDGE;
+
+      jakesteringDispatchEvent( events[i].offset, id, events[i].timestamp_ns );
+    }
+  }
+
+  return count;
+}
+
+/*
+ * Read every queued event off a pin's line fd and dispatch them
+ *
+ * Parameters:
+ *  pin: GPIO pin to drain
+ *
+ * Return:
+ *  number of events dispatched
+ **************************************************************
+ */
+
+static int drain_events( const int pin )
+{
+  struct gpio_v2_line_event events[16]; //room for 16 line request events or 48 single line ones
+  int total = 0;
+
+  for (;;)
+  {
+    int readret = read( pin_FDs[pin], events, sizeof( events ) );
+    if ( readret <= 0 )
+    {
+      break;
+    }
+
+    total += jakesteringDispatchRead( pin, events, readret );
+
+    if ( readret < (int)sizeof( events ) )
+    {
+      break;
+    }
+  }
+
+  return total;
+}
+
+/*
+ * Get the single pollable fd that covers every pin registered with
+ * jakesteringPollISR. It becomes readable whenever any of those pins has
+ * events queued, so it can be added to an existing epoll/libuv loop.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  fd to poll for POLLIN, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringPollFd( void )
+{
+  if ( poll_FD < 0 )
+  {
+    poll_FD = epoll_create1( EPOLL_CLOEXEC );
+    if ( poll_FD < 0 )
+    {
+      printf( "Failed: epoll_create1 returned %d\n", poll_FD );
+      return -1;
+    }
+  }
+
+  return poll_FD;
+}
+
+/*
+ * Request a pin's line fd and add it to the epoll set
+ *
+ * Parameters:
+ *  pin : GPIO pin to watch
+ *  mode: RISING_EDGE/FALLING_EDGE/BOTH_EDGE
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+static int poll_register( const int pin, const int mode )
+{
+  struct epoll_event ev;
+
+  if ( jakesteringPollFd() < 0 )
+  {
+    return -1;
+  }
+
+  isr_modes[pin] = mode;
+
+  if ( interrupt_init( pin, mode ) < 0 )
+  {
+    printf( "Waiting for interrupt init failed\n" );
+    return -1;
+  }
+
+  memset( &ev, 0, sizeof( ev ) );
+  ev.events = EPOLLIN;
+  ev.data.u32 = pin;
+
+  if ( epoll_ctl( poll_FD, EPOLL_CTL_ADD, pin_FDs[pin], &ev ) < 0 )
+  {
+    printf( "Failed: epoll_ctl add pin %d\n", pin );
+    close( pin_FDs[pin] );
+    pin_FDs[pin] = -1;
+    return -1;
+  }
+
+  poll_pins |= ( 1u << pin );
+
+  if ( gpioUringFd() >= 0 && gpioUringArm( pin ) < 0 ) //the ring is already reaping, give it this pin too
+  {
+    printf( "Failed: could not arm pin %d\n", pin );
+  }
+
+  return 0;
+}
+
+/*
+ * Register a callback for a pin without spawning a thread. Events are
+ * delivered from jakesteringDispatchPending in the caller's own loop.
+ *
+ * Parameters:
+ *  pin     : GPIO pin to watch
+ *  mode    : RISING_EDGE/FALLING_EDGE/BOTH_EDGE
+ *  function: called once for every event on the pin
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringPollISR( const int pin, const int mode, void (*function)(void) )
+{
+  isr_functions[pin] = function;
+
+  if ( poll_register( pin, mode ) < 0 )
+  {
+    isr_functions[pin] = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Same as jakesteringPollISR, but the callback is told which pin and edge
+ * fired and when, so one handler can serve several pins.
+ *
+ * Parameters:
+ *  pin     : GPIO pin to watch
+ *  mode    : RISING_EDGE/FALLING_EDGE/BOTH_EDGE
+ *  function: called with the pin, RISING_EDGE/FALLING_EDGE, the kernel
+ *            timestamp in nanoseconds and arg
+ *  arg     : passed through to function
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringPollEvent( const int pin, const int mode, void (*function)( int pin, int edge, uint64_t timestamp, void *arg ), void *arg )
+{
+  event_functions[pin] = function;
+  event_args[pin] = arg;
+
+  if ( poll_register( pin, mode ) < 0 )
+  {
+    event_functions[pin] = NULL;
+    event_args[pin] = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Same as jakesteringPollEvent for several pins requested as one line.
+ * The kernel queues their edges on a single fd in the order they
+ * happened, so a handler that decodes the pins together never sees one
+ * pin's edges ahead of another's. The request is registered, read and
+ * closed through its first pin.
+ *
+ * Parameters:
+ *  pins    : GPIO pins to watch, pins[ 0 ] names the request
+ *  count   : number of pins, 1 to 32
+ *  mode    : RISING_EDGE/FALLING_EDGE/BOTH_EDGE
+ *  function: called with the pin, RISING_EDGE/FALLING_EDGE, the kernel
+ *            timestamp in nanoseconds and arg
+ *  arg     : passed through to function
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringPollEventLines( const int *pins, const int count, const int mode, void (*function)( int pin, int edge, uint64_t timestamp, void *arg ), void *arg )
+{
+  struct gpio_v2_line_request req;
+  struct epoll_event ev;
+  uint32_t group = 0;
+  int pin = pins[0];
+
+  if ( count < 1 || count > 32 )
+  {
+    printf( "Failed: a line request takes 1 to 32 pins\n" );
+    return -1;
+  }
+
+  if ( jakesteringPollFd() < 0 || chip_open() < 0 )
+  {
+    return -1;
+  }
+
+  memset( &req, 0, sizeof( req ) );
+
+  for ( int i = 0; i < count; i++ )
+  {
+    req.offsets[i] = pins[i];
+    group |= ( 1u << pins[i] );
+  }
+
+  req.num_lines = count;
+  req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+  req.config.flags |= ( mode == FALLING_EDGE ) ? GPIO_V2_LINE_FLAG_EDGE_FALLING : ( mode == RISING_EDGE ) ? GPIO_V2_LINE_FLAG_EDGE_RISING : GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+  strncpy( req.consumer, "jakestering_gpio_irq", sizeof( req.consumer ) - 1 );
+
+  if ( ioctl( chip_FD, GPIO_V2_GET_LINE_IOCTL, &req ) < 0 )
+  {
+    printf( "Failed: ioctl get %d lines from pin %d: %s\n", count, pin, strerror( errno ) );
+    return -1;
+  }
+
+  if ( fcntl( req.fd, F_SETFL, fcntl( req.fd, F_GETFL ) | O_NONBLOCK ) < 0 )
+  {
+    printf( "Failed: fcntl set nonblock on pin %d\n", pin );
+    close( req.fd );
+    return -1;
+  }
+
+  memset( &ev, 0, sizeof( ev ) );
+  ev.events = EPOLLIN;
+  ev.data.u32 = pin;
+
+  if ( epoll_ctl( poll_FD, EPOLL_CTL_ADD, req.fd, &ev ) < 0 )
+  {
+    printf( "Failed: epoll_ctl add pin %d\n", pin );
+    close( req.fd );
+    return -1;
+  }
+
+  for ( int i = 0; i < count; i++ )
+  {
+    event_functions[pins[i]] = function;
+    event_args[pins[i]] = arg;
+  }
+
+  pin_FDs[pin] = req.fd;
+  isr_modes[pin] = mode;
+  line_groups[pin] = group;
+  poll_pins |= ( 1u << pin );
+
+  if ( gpioUringFd() >= 0 && gpioUringArm( pin ) < 0 )
+  {
+    printf( "Failed: could not arm pin %d\n", pin );
+  }
+
+  return 0;
+}
+
+/*
+ * Drain and dispatch every event pending on the pins registered with
+ * jakesteringPollISR. Never blocks; call it when jakesteringPollFd is readable.
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  number of events dispatched, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringDispatchPending( void )
+{
+  struct epoll_event ready[32];
+  int dispatched = 0;
+
+  if ( poll_FD < 0 )
+  {
+    return -1;
+  }
+
+  int count = epoll_wait( poll_FD, ready, 32, 0 );
+  if ( count < 0 )
+  {
+    return -1;
+  }
+
+  for ( int i = 0; i < count; i++ )
+  {
+    dispatched += drain_events( ready[i].data.u32 );
+  }
+
+  return dispatched;
+}
+
+/*
+ * Get the pins currently registered with jakesteringPollISR
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  bitmask with bit n set for every registered pin n
+ **************************************************************
+ */
+
+uint32_t jakesteringPollPins( void )
+{
+  return poll_pins;
+}
+
+/*
+ * Get the line event fd requested for a pin
+ *
+ * Parameters:
+ *  pin: GPIO pin
+ *
+ * Return:
+ *  line fd, -1 if the pin has none
+ **************************************************************
+ */
+
+int jakesteringLineFd( const int pin )
+{
+  if ( !( poll_pins & ( 1u << pin ) ) )
+  {
+    return -1;
+  }
+
+  return pin_FDs[pin];
+}
+
+/*
+ * Stop watching a pin registered with jakesteringPollISR. The first pin
+ * of a jakesteringPollEventLines request releases all of its pins.
+ *
+ * Parameters:
+ *  pin: GPIO pin to release
+ *
+ * Return:
+ *  0 on success, -1 if the pin was not registered
+ **************************************************************
+ */
+
+int jakesteringPollClose( const int pin )
+{
+  if ( !( poll_pins & ( 1u << pin ) ) )
+  {
+    return -1;
+  }
+
+  gpioUringCancel( pin ); //a read left in flight could land on a file that reuses the fd
+  epoll_ctl( poll_FD, EPOLL_CTL_DEL, pin_FDs[pin], NULL );
+  close( pin_FDs[pin] );
+
+  for ( int other = 0; other < 32; other++ )
+  {
+    if ( line_groups[pin] & ( 1u << other ) ) //the rest of a line request goes with it
+    {
+      event_functions[other] = NULL;
+      event_args[other] = NULL;
+    }
+  }
+
+  pin_FDs[pin] = -1;
+  isr_functions[pin] = NULL;
+  event_functions[pin] = NULL;
+  event_args[pin] = NULL;
+  line_groups[pin] = 0;
+  poll_pins &= ~( 1u << pin );
+
+  return 0;
+}
+
+/*
+ * Run a readback test enough times in a row to trust the result
+ *
+ * Parameters:
+ *  test  : writes a pattern and reads it back, 1 when it matched
+ *  device: passed to test
+ * 
+ * Return:
+ *  1 if every run passed, otherwise 0
+ **************************************************************
+ */
+
+static int calibrate_passes( int (*test)( void *device ), void *device )
+{
+  for ( int i = 0; i < CALIBRATE_REPEATS; i++ )
+  {
+    if ( !test( device ) )
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*
+ * Binary search the shortest enable pulse, hold and byte gap a device
+ * still reads back correctly, one after the other. Each result gets the
+ * safety margin before the next is searched, so later searches don't
+ * run on the edge of an earlier one.
+ *
+ * Parameters:
+ *  timing: timing the test runs with, set to the result
+ *  safe  : worst case timing, the upper bound of every search
+ *  test  : writes a pattern and reads it back, 1 when it matched
+ *  device: passed to test
+ *  margin: percent added to each minimum found
+ * 
+ * Return:
+ *  0 on success, -1 if the device fails at safe timing, timing is left safe
+ **************************************************************
+ */
+
+int jakesteringCalibrate( BusTiming *timing, const BusTiming *safe, int (*test)( void *device ), void *device, const int margin )
+{
+  int *fields[ 3 ] = { &timing->enableNanos, &timing->holdNanos, &timing->gapNanos };
+  const int limits[ 3 ] = { safe->enableNanos, safe->holdNanos, safe->gapNanos };
+
+  *timing = *safe;
+
+  if ( !calibrate_passes( test, device ) )
+  {
+    printf( "Failed: device does not read back at safe timing\n" );
+    return -1;
+  }
+
+  for ( int field = 0; field < 3; field++ )
+  {
+    int low = 0;
+    int high = limits[ field ];
+
+    while ( high - low > CALIBRATE_RESOLUTION )
+    {
+      int middle = ( low + high ) / 2;
+
+      *fields[ field ] = middle;
+
+      if ( calibrate_passes( test, device ) )
+      {
+        high = middle;
+      }
+
+      else
+      {
+        low = middle;
+      }
+    }
+
+    *fields[ field ] = MIN( high + high * margin / 100, limits[ field ] );
+  }
+
+  if ( !calibrate_passes( test, device ) )
+  {
+    printf( "Failed: calibrated timing did not verify, keeping safe timing\n" );
+    *timing = *safe;
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Save calibrated timing so later runs can skip calibration
+ *
+ * Parameters:
+ *  timing: timing to save
+ *  path  : file to write
+ * 
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int jakesteringSaveTiming( const BusTiming *timing, const char *path )
+{
+  FILE *file = fopen( path, "w" );
+
+  if ( file == NULL )
+  {
+    printf( "Failed: to open %s: %s\n", path, strerror( errno ) );
+    return -1;
+  }
+
+  fprintf( file, "enable %d\nhold %d\ngap %d\n", timing->enableNanos, timing->holdNanos, timing->gapNanos );
+
+  return fclose( file ) == 0 ? 0 : -1;
+}
+
+/*
+ * Load timing saved by jakesteringSaveTiming
+ *
+ * Parameters:
+ *  timing: set to the saved timing, untouched on failure
+ *  path  : file to read
+ * 
+ * Return:
+ *  0 on success, -1 if there is no valid saved timing
+ **************************************************************
+ */
+
+int jakesteringLoadTiming( BusTiming *timing, const char *path )
+{
+  FILE *file = fopen( path, "r" );
+  BusTiming loaded;
+
+  if ( file == NULL )
+  {
+    return -1;
+  }
+
+  int fields = fscanf( file, "enable %d hold %d gap %d", &loaded.enableNanos, &loaded.holdNanos, &loaded.gapNanos );
+
+  fclose( file );
+
+  if ( fields != 3 || loaded.enableNanos < 0 || loaded.holdNanos < 0 || loaded.gapNanos < 0 )
+  {
+    printf( "Failed: %s does not hold bus timing\n", path );
+    return -1;
+  }
+
+  *timing = loaded;
+
+  return 0;
+}
 
@@ -147,3 +147,96 @@ char checkKeypad( Keypad kp, int pageNumber )
   return '\0';
 }
 
+/*
+ * Register every key of a keypad with a debouncer. Keys are reported with
+ * KEYPAD_KEY( row, col ) ids, use keypadKeyChar to map them to characters.
+ *
+ * Parameters:
+ *  db         : debouncer to register with
+ *  settleMs   : time a key must hold before it is accepted
+ *  longPressMs: hold time before LONG_PRESS, 0 to disable
+ *  repeatMs   : REPEAT period after a long press, 0 to disable
+ *  function   : called with the key id and a DEBOUNCE_* event
+ *
+ * Return:
+ *  0 on success, -1 if the debouncer is full
+ */
+
+int keypadDebounce( Debouncer *db, int settleMs, int longPressMs, int repeatMs, void (*function)( int key, int event ) )
+{
+  for ( int i = 0; i < 4; i++ )
+  {
+    for ( int j = 0; j < 4; j++ )
+    {
+      if ( debounceAdd( db, KEYPAD_KEY( i, j ), LOW, settleMs, 0, longPressMs, repeatMs, function ) < 0 )
+      {
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Scan the keypad once and feed every key to the debouncer. Unlike
+ * checkKeypad this never sleeps; call it from the main loop along with
+ * debounceTick.
+ *
+ * Parameters:
+ *  kp   : keypad that is being scanned
+ *  db   : debouncer the keys were registered with
+ *  nowMs: current time in milli seconds
+ *
+ * Return:
+ *  void
+ */
+
+void scanKeypad( Keypad kp, Debouncer *db, uint64_t nowMs )
+{
+  for ( int i = 0; i < 4; i++ )
+  {
+    digitalWrite( kp.ROWS[ i ], LOW );
+
+    for ( int j = 0; j < 4; j++ )
+    {
+      debounceUpdate( db, KEYPAD_KEY( i, j ), digitalRead( kp.COLS[ j ] ), nowMs );
+    }
+
+    digitalWrite( kp.ROWS[ i ], HIGH );
+  }
+}
+
+/*
+ * Get the character for a debounced keypad key
+ *
+ * Parameters:
+ *  key       : KEYPAD_KEY id passed to the debounce callback
+ *  pageNumber: what page of the keypad are you on
+ *
+ * Return:
+ *  char for the key, '\0' if the id is not a keypad key
+ */
+
+char keypadKeyChar( int key, int pageNumber )
+{
+  int index = key - KEYPAD_KEY_BASE;
+
+  if ( index < 0 || index >= 16 )
+  {
+    return '\0';
+  }
+
+  switch ( pageNumber )
+  {
+    case 1:
+      return keypadTablePage1[ index / 4 ][ index % 4 ];
+
+    case 2:
+      return keypadTablePage2[ index / 4 ][ index % 4 ];
+
+    default:
+      return keypadTablePage0[ index / 4 ][ index % 4 ];
+  }
+}
+
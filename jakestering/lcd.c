@@ -25,12 +25,93 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c-dev.h>
 
 #include "lcd.h"
 #include "jakestering.h"
 
 static const int rowsOffset[4] = { 0b00000000, 0b01000000, 0b00010100, 0b01010100 }; //0x00, 0x40, 0x14, 0x54
 
+static const BusTiming safeTiming = { LCD_ENABLE_NANOS, LCD_HOLD_NANOS, LCD_EXEC_MICRO * 1000 };
+
+/*
+ * Async writer commands
+ */
+
+#define LCD_CMD_PUTCHAR     0
+#define LCD_CMD_POSITION    1
+#define LCD_CMD_CLEAR       2
+#define LCD_CMD_INSTRUCTION 3
+#define LCD_CMD_SCREEN_PUT  4
+#define LCD_CMD_FENCE       5
+#define LCD_CMD_STOP        6
+#define LCD_CMD_GLYPH       7
+#define LCD_CMD_SHIFT       8
+#define LCD_CMD_DDRAM       9
+#define LCD_CMD_BACKLIGHT   10
+
+/*
+ * Queue a command for the writer thread. Producers claim a slot with a
+ * CAS on the enqueue index and publish it through the slot's sequence.
+ *
+ * Parameters:
+ *  lcd  : lcd in async mode
+ *  type : LCD_CMD_*
+ *  x    : column, when the command takes one
+ *  y    : row, when the command takes one
+ *  value: character or instruction
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdEnqueue( LCD *lcd, const int type, const int x, const int y, const int value )
+{
+  LcdQueue *queue = lcd->queue;
+  unsigned int position = __atomic_load_n( &queue->enqueue, __ATOMIC_RELAXED );
+  LcdCommand *command;
+
+  for (;;)
+  {
+    command = &queue->commands[ position & ( LCD_QUEUE_SIZE - 1 ) ];
+    int difference = ( int )( __atomic_load_n( &command->sequence, __ATOMIC_ACQUIRE ) - position );
+
+    if ( difference == 0 )
+    {
+      if ( __atomic_compare_exchange_n( &queue->enqueue, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+      {
+        break;
+      }
+    }
+
+    else if ( difference < 0 )
+    {
+      sched_yield(); //full, let the writer drain it
+      position = __atomic_load_n( &queue->enqueue, __ATOMIC_RELAXED );
+    }
+
+    else
+    {
+      position = __atomic_load_n( &queue->enqueue, __ATOMIC_RELAXED );
+    }
+  }
+
+  command->type = type;
+  command->x = x;
+  command->y = y;
+  command->value = value;
+  __atomic_store_n( &command->sequence, position + 1, __ATOMIC_RELEASE );
+
+  sem_post( &queue->wake );
+}
+
 /* 
  * Pulse the enable line
  *
@@ -45,308 +126,1825 @@ static const int rowsOffset[4] = { 0b00000000, 0b01000000, 0b00010100, 0b0101010
 void pulseEnable( LCD *lcd )
 {
   digitalWrite( lcd->E, HIGH );
-  delayMicro( 1 );
+  delayNano( lcd->timing.enableNanos );
   digitalWrite( lcd->E, LOW  );
-  delayMicro( 5 );
+  delayNano( lcd->timing.holdNanos );
 }
 
-/* 
- * Send a byte of data out to the lcd
+/*
+ * Set the data bus direction
  *
  * Parameters:
- *  lcd: lcd to receive data
- *  data: the byte to be sent
- * 
+ *  lcd : lcd owning the bus
+ *  mode: INPUT/OUTPUT
+ *
  * Return:
  *  void
  **************************************************************
  */
 
-void sendData( LCD *lcd, const int data )
+static void lcdBusMode( LCD *lcd, const int mode )
 {
-  digitalWriteByte( data, lcd->DB0, lcd->DB7 );
-  pulseEnable( lcd );
-  delay( 2 );
+  pinMode( lcd->DB0, mode );
+  pinMode( lcd->DB1, mode );
+  pinMode( lcd->DB2, mode );
+  pinMode( lcd->DB3, mode );
+  pinMode( lcd->DB4, mode );
+  pinMode( lcd->DB5, mode );
+  pinMode( lcd->DB6, mode );
+  pinMode( lcd->DB7, mode );
 }
 
-/* 
- * Send an instruction to the lcd. Register select is set high for sending data
- * must be set low to send instruction.
+/*
+ * Execution time of an instruction
  *
  * Parameters:
- *  lcd: lcd to receive instruction
- *  instruction: byte to send
- * 
+ *  instruction: instruction byte
+ *
  * Return:
- *  void
+ *  time in micro seconds before the next write is accepted
  **************************************************************
  */
 
-void sendInstruction( LCD *lcd, const int instruction )
+static int lcdInstructionMicro( const int instruction )
 {
-  digitalWrite( lcd->RS, LOW  );
-  sendData( lcd, instruction );
-  digitalWrite( lcd->RS, HIGH );
+  if ( instruction == LCD_CLEAR || ( instruction & 0b11111110 ) == LCD_HOME )
+  {
+    return LCD_EXEC_HOME_MICRO;
+  }
+
+  return LCD_EXEC_MICRO;
 }
 
 /*
- * Move the cursor
+ * Wait until the lcd can take the next write. With RW wired the busy flag
+ * (DB7) is polled, so the wait ends as soon as the controller is done;
+ * otherwise the worst case execution time is slept.
  *
  * Parameters:
- *  x: move horizontally this amount
- *  y: move vertically this amount
+ *  lcd      : lcd to wait on
+ *  execMicro: execution time of the last write
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdPosition( LCD *lcd, int x, int y )
+void lcdWaitReady( LCD *lcd, const int execMicro )
 {
-  if ( ( x > lcd->cols ) || ( x < 0 ) )
+  if ( execMicro == LCD_EXEC_MICRO && lcd->timing.gapNanos < safeTiming.gapNanos ) //calibrated, cheaper than a busy poll
   {
+    delayNano( lcd->timing.gapNanos );
     return;
   }
 
-  if ( ( y > lcd->rows ) || ( y < 0 ) )
+  if ( lcd->RW < 0 )
   {
+    delayMicro( execMicro );
     return;
   }
 
-  sendInstruction( lcd, x + ( LCD_DDRAM | rowsOffset[y] ) );
+  uint64_t start = micros();
+  int busy;
 
-  lcd->cx = x;
-  lcd->cy = y;
+  lcdBusMode( lcd, INPUT );
+  digitalWrite( lcd->RS, LOW  );
+  digitalWrite( lcd->RW, HIGH );
+
+  do
+  {
+    digitalWrite( lcd->E, HIGH );
+    delayNano( lcd->timing.enableNanos );
+    busy = digitalRead( lcd->DB7 );
+    digitalWrite( lcd->E, LOW );
+    delayNano( lcd->timing.enableNanos );
+  } while ( busy && ( micros() - start ) < LCD_BUSY_TIMEOUT );
+
+  digitalWrite( lcd->RW, LOW  );
+  digitalWrite( lcd->RS, HIGH );
+  lcdBusMode( lcd, OUTPUT );
 }
 
-/* 
- * Print a char to the lcd
+/*
+ * Step the shadow address counter past one data write, following the
+ * controller's wrap between the two DDRAM lines
  *
  * Parameters:
- *  lcd      : lcd to print to  
- *  character: char
- *  
+ *  lcd: lcd whose address counter moved
+ *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdPutChar( LCD *lcd, unsigned char character )
+static void lcdStepAddress( LCD *lcd )
 {
-  sendData( lcd, character );
-  
-  if ( ++lcd->cx == lcd->cols )
+  if ( lcd->address < 0 )
   {
-    lcd->cx = 0;
-    
-    if ( ++lcd->cy == lcd->rows )
-    {
-      lcd->cy = 0;
-    }
+    return;
+  }
 
-    lcdPosition( lcd, lcd->cx, lcd->cy );
+  if ( lcd->increment )
+  {
+    lcd->address = ( lcd->address == 0x27 ) ? 0x40 : ( lcd->address == 0x67 ) ? 0x00 : lcd->address + 1;
+  }
+
+  else
+  {
+    lcd->address = ( lcd->address == 0x40 ) ? 0x27 : ( lcd->address == 0x00 ) ? 0x67 : lcd->address - 1;
   }
 }
 
-/* 
- * Print a string to the lcd
+/*
+ * DDRAM address of a screen cell. The display shift moves the window on
+ * each 40 cell line, so it is added here and wraps like the controller.
  *
  * Parameters:
- *  lcd   : lcd to print to  
- *  string: string
- *  
+ *  lcd: lcd the cell is on
+ *  x  : column
+ *  y  : row
+ *
+ * Return:
+ *  DDRAM address
+ **************************************************************
+ */
+
+static int lcdCellAddress( LCD *lcd, int x, int y )
+{
+  int line = rowsOffset[ y ] & 0b01000000;
+
+  return line | ( ( ( rowsOffset[ y ] & 0b00111111 ) + x + lcd->shift ) % LCD_LINE_LENGTH );
+}
+
+/*
+ * Set the virtual screen to what the shadow DDRAM shows through the
+ * current display shift
+ *
+ * Parameters:
+ *  lcd: lcd to sync
+ *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdPuts( LCD *lcd, const char* string )
+static void lcdScreenSync( LCD *lcd )
 {
-  while ( *string )
+  for ( int y = 0; y < lcd->rows; y++ )
   {
-    lcdPutChar( lcd, *string++ );
+    for ( int x = 0; x < lcd->cols; x++ )
+    {
+      lcd->screen[ y ][ x ] = lcd->ddram[ lcdCellAddress( lcd, x, y ) ];
+    }
   }
 }
 
-/* 
- * Print a formated string to the lcd
+/*
+ * Hold back transport writes until the matching lcdBatchEnd, so a run of
+ * bytes goes out in as few transfers as the transport allows
  *
  * Parameters:
- *  lcd   : lcd to print to  
- *  string: formated string
- *  
+ *  lcd: lcd being written
+ *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdPrintf( LCD *lcd, const char *string, ... )
+static void lcdBatchBegin( LCD *lcd )
 {
-  char buffer[ 1024 ];
-  va_list args;
-
-  va_start( args, string );
-  vsnprintf( buffer, sizeof( buffer ), string, args );
-  va_end( args );
-
-  lcdPuts( lcd, buffer );
+  lcd->batch++;
 }
 
 /*
- * Clears the lcd
+ * End a batch, sending what was held back once the outermost one ends
  *
  * Parameters:
- *  lcd: screen to clear
+ *  lcd: lcd being written
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdClear( LCD *lcd )
+static void lcdBatchEnd( LCD *lcd )
 {
-  sendInstruction( lcd, LCD_CLEAR );
-  delay( 2 );
-  sendInstruction( lcd, LCD_HOME );
-  lcd->cx = 0;
-  lcd->cy = 0;
-  delay( 5 );
+  if ( --lcd->batch == 0 && lcd->transportFlush )
+  {
+    lcd->transportFlush( lcd );
+  }
 }
 
 /*
- * Set the display on/off 
+ * Parallel transport, one byte on DB0-DB7 per enable pulse. RS rests
+ * high so only instructions touch it.
  *
  * Parameters:
- *  lcd  : screen
- *  value: 1 = on | 0 = off
+ *  lcd      : lcd to write
+ *  rs       : HIGH = data | LOW = instruction
+ *  data     : byte to send
+ *  execMicro: execution time of the write
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdDisplay( LCD *lcd, int value )
+static void lcdParallelWrite( LCD *lcd, const int rs, const int data, const int execMicro )
 {
-  if ( value )
+  if ( rs == LOW )
   {
-    sendInstruction( lcd, LCD_CONTROL | D_CONTROL );
-    return;
+    digitalWrite( lcd->RS, LOW );
   }
 
-  else
+  digitalWriteByte( data, lcd->DB0, lcd->DB7 );
+  pulseEnable( lcd );
+
+  if ( rs == LOW )
   {
-    sendInstruction( lcd, LCD_CONTROL );
-    return;
+    digitalWrite( lcd->RS, HIGH );
   }
+
+  lcdWaitReady( lcd, execMicro );
 }
 
 /*
- * Turn off/on cursor
+ * Send the bytes held for the PCF8574 in one i2c transfer
  *
  * Parameters:
- *  lcd  : screen to set cursor
- *  value: 1 = set cursor on | 0 = set cursor off
+ *  lcd: lcd on i2c
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdCursor( LCD *lcd, int value )
+static void lcdI2cFlush( LCD *lcd )
 {
-  if ( value )
+  if ( lcd->i2cLength == 0 )
   {
-    sendInstruction( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL );
     return;
   }
 
-  else
+  if ( write( lcd->i2cFd, lcd->i2cBuffer, lcd->i2cLength ) != lcd->i2cLength )
   {
-    sendInstruction( lcd, LCD_CONTROL | D_CONTROL );
-    return;
+    printf( "Failed: lcd i2c write: %s\n", strerror( errno ) );
   }
+
+  lcd->i2cLength = 0;
 }
 
 /*
- * Set the cursor to blink
+ * Queue one nibble for the PCF8574 as two port writes, E high then E low,
+ * the falling edge latching it
  *
  * Parameters:
- *  lcd  : screen with cursor to blink
- *  value: 1 = on | 0 = off
+ *  lcd : lcd on i2c
+ *  bits: nibble in the top 4 bits, RS and backlight in the low ones
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcdCursorBlink( LCD *lcd, int value )
+static void lcdI2cNibble( LCD *lcd, const int bits )
 {
-  if ( value )
+  if ( lcd->i2cLength + 2 > LCD_I2C_BUFFER )
   {
-    sendInstruction( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL | B_CONTROL );
-    return;
+    lcdI2cFlush( lcd );
   }
 
-  else
+  lcd->i2cBuffer[ lcd->i2cLength++ ] = bits | LCD_I2C_E;
+  lcd->i2cBuffer[ lcd->i2cLength++ ] = bits;
+}
+
+/*
+ * I2C transport through a PCF8574 backpack in 4-bit mode. Inside a batch
+ * bytes are only buffered; every port write on the bus takes longer than
+ * a 37 us instruction, so only clear and home need a real wait.
+ *
+ * Parameters:
+ *  lcd      : lcd on i2c
+ *  rs       : HIGH = data | LOW = instruction
+ *  data     : byte to send
+ *  execMicro: execution time of the write
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdI2cWrite( LCD *lcd, const int rs, const int data, const int execMicro )
+{
+  int control = ( rs ? LCD_I2C_RS : 0 ) | ( lcd->backlight ? LCD_I2C_BACKLIGHT : 0 );
+
+  if ( lcd->i2cLength + 4 > LCD_I2C_BUFFER ) //keep both nibbles of a byte in one transfer
   {
-    sendInstruction( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL );
-    return;
+    lcdI2cFlush( lcd );
+  }
+
+  lcdI2cNibble( lcd, ( data & 0xF0 ) | control );
+  lcdI2cNibble( lcd, ( ( data << 4 ) & 0xF0 ) | control );
+
+  if ( execMicro > LCD_EXEC_MICRO )
+  {
+    lcdI2cFlush( lcd );
+    delayMicro( execMicro );
+  }
+
+  else if ( lcd->batch == 0 )
+  {
+    lcdI2cFlush( lcd );
+  }
+}
+
+/* 
+ * Send a byte of data out to the lcd
+ *
+ * Parameters:
+ *  lcd: lcd to receive data
+ *  data: the byte to be sent
+ * 
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void sendData( LCD *lcd, const int data )
+{
+  lcd->transportWrite( lcd, HIGH, data, LCD_EXEC_MICRO );
+
+  if ( lcd->address >= 0 )
+  {
+    lcd->ddram[ lcd->address ] = data;
+    lcdStepAddress( lcd );
   }
 }
 
 /* 
- * Initialize the lcd
+ * Send an instruction to the lcd. Register select is set high for sending data
+ * must be set low to send instruction.
  *
  * Parameters:
- *  RS    : register select
- *  RW    : read/write
- *  E     : enable
- *  DB0-7 : data lines
+ *  lcd: lcd to receive instruction
+ *  instruction: byte to send
  * 
  * Return:
- *  LCD : that has been initialized
+ *  void
  **************************************************************
  */
 
-LCD* initLcd( int rows, int cols, int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7 )
+void sendInstruction( LCD *lcd, const int instruction )
 {
-  LCD *lcd = ( LCD* )malloc( sizeof( LCD ) );
-  
-  lcd->RS  =  RS;
-  lcd->E   =   E;
-  lcd->DB0 = DB0;
-  lcd->DB1 = DB1;
-  lcd->DB2 = DB2;
-  lcd->DB3 = DB3;
-  lcd->DB4 = DB4;
-  lcd->DB5 = DB5;
-  lcd->DB6 = DB6;
-  lcd->DB7 = DB7;
-  
-  lcd->rows = rows;
-  lcd->cols = cols;
-  
-  lcd->cx = 0;
-  lcd->cy = 0;
+  lcd->transportWrite( lcd, LOW, instruction, lcdInstructionMicro( instruction ) );
 
-  pinMode( lcd->RS , OUTPUT );
-  pinMode( lcd->E  , OUTPUT );
-  pinMode( lcd->DB0, OUTPUT );
-  pinMode( lcd->DB1, OUTPUT );
-  pinMode( lcd->DB2, OUTPUT );
-  pinMode( lcd->DB3, OUTPUT );
-  pinMode( lcd->DB4, OUTPUT );
-  pinMode( lcd->DB5, OUTPUT );
-  pinMode( lcd->DB6, OUTPUT );
-  pinMode( lcd->DB7, OUTPUT );
+  if ( instruction & LCD_DDRAM )
+  {
+    lcd->address = instruction & 0b01111111;
+  }
 
-  digitalWrite( lcd->RS, HIGH );
-  digitalWrite( lcd->E , LOW  );
+  else if ( instruction & LCD_CGRAM )
+  {
+    lcd->address = -1; //data writes go to CGRAM until the next DDRAM set
+  }
 
-  sendInstruction( lcd, 0b00111000 ); //Set 8-bit operation, 2-line mode, 5x8 character font
-  sendInstruction( lcd, 0b00001100 ); //Set display on, cursor on, cursor blinking off
-  sendInstruction( lcd, 0b00000110 ); //Set entry mode, increment address
+  else if ( instruction == LCD_CLEAR )
+  {
+    memset( lcd->ddram, ' ', sizeof( lcd->ddram ) );
+    lcd->address = 0;
+    lcd->increment = 1;
+    lcd->shift = 0;
+  }
 
-  return lcd;
+  else if ( ( instruction & 0b11111110 ) == LCD_HOME )
+  {
+    lcd->address = 0;
+    lcd->shift = 0;
+  }
+
+  else if ( ( instruction & 0b11110000 ) == LCD_CURSOR_SHIFT )
+  {
+    if ( instruction & LCD_SC_SHIFT )
+    {
+      lcd->shift = ( lcd->shift + ( ( instruction & LCD_RL_SHIFT ) ? LCD_LINE_LENGTH - 1 : 1 ) ) % LCD_LINE_LENGTH;
+    }
+
+    else
+    {
+      lcd->address = -1;
+    }
+  }
+
+  else if ( ( instruction & 0b11111000 ) == LCD_CONTROL )
+  {
+    lcd->control = instruction;
+  }
+
+  else if ( ( instruction & 0b11111100 ) == LCD_ENTRY )
+  {
+    lcd->increment = instruction & ID_ENTRY;
+  }
+}
+
+/*
+ * Read a byte back from the lcd, RW must be wired
+ *
+ * Parameters:
+ *  lcd: lcd to read
+ *  rs : HIGH = data at the address counter | LOW = busy flag and address
+ *
+ * Return:
+ *  the byte read
+ **************************************************************
+ */
+
+static int lcdReadByte( LCD *lcd, const int rs )
+{
+  const int pins[ 8 ] = { lcd->DB0, lcd->DB1, lcd->DB2, lcd->DB3, lcd->DB4, lcd->DB5, lcd->DB6, lcd->DB7 };
+  int data = 0;
+
+  lcdBusMode( lcd, INPUT );
+  digitalWrite( lcd->RS, rs );
+  digitalWrite( lcd->RW, HIGH );
+
+  digitalWrite( lcd->E, HIGH );
+  delayNano( lcd->timing.enableNanos );
+
+  for ( int i = 0; i < 8; i++ )
+  {
+    data |= digitalRead( pins[ i ] ) << i;
+  }
+
+  digitalWrite( lcd->E, LOW );
+  delayNano( lcd->timing.holdNanos );
+
+  digitalWrite( lcd->RW, LOW  );
+  digitalWrite( lcd->RS, HIGH );
+  lcdBusMode( lcd, OUTPUT );
+
+  if ( rs == HIGH )
+  {
+    lcdWaitReady( lcd, LCD_EXEC_MICRO ); //a data read moves the address counter like a write
+    lcdStepAddress( lcd );
+  }
+
+  return data;
+}
+
+/*
+ * Write a pattern over the first DDRAM line and read it back. Address
+ * sets use safe timing so a failed candidate can't corrupt the mode.
+ *
+ * Parameters:
+ *  device: the LCD, with the candidate timing set
+ *
+ * Return:
+ *  1 if every byte read back, otherwise 0
+ **************************************************************
+ */
+
+static int lcdCalibrationTest( void *device )
+{
+  static unsigned int seed = 0;
+  LCD *lcd = ( LCD* )device;
+  BusTiming candidate = lcd->timing;
+  unsigned char pattern[ LCD_LINE_LENGTH ];
+  int passed = 1;
+
+  seed++; //a new pattern each run, so stale data from the last one can't pass
+
+  for ( int i = 0; i < LCD_LINE_LENGTH; i++ )
+  {
+    pattern[ i ] = ( ( i * 73 + seed * 151 ) ^ ( ( i & 1 ) ? 0x55 : 0xAA ) ) & 0xFF;
+  }
+
+  lcd->timing = safeTiming;
+  sendInstruction( lcd, LCD_DDRAM );
+  lcd->timing = candidate;
+
+  for ( int i = 0; i < LCD_LINE_LENGTH; i++ )
+  {
+    sendData( lcd, pattern[ i ] );
+  }
+
+  lcd->timing = safeTiming;
+  sendInstruction( lcd, LCD_DDRAM );
+  lcd->timing = candidate;
+
+  for ( int i = 0; i < LCD_LINE_LENGTH; i++ )
+  {
+    if ( lcdReadByte( lcd, HIGH ) != pattern[ i ] )
+    {
+      passed = 0;
+    }
+  }
+
+  return passed;
+}
+
+/*
+ * Find the fastest bus timing this panel handles by writing and reading
+ * back DDRAM, keeping it in lcd->timing. Save it with
+ * jakesteringSaveTiming and load it on later runs to skip this. The first
+ * DDRAM line is rewritten from the shadow afterwards.
+ *
+ * Parameters:
+ *  lcd   : parallel lcd with RW wired, not in async mode
+ *  margin: percent added to each minimum found
+ *
+ * Return:
+ *  0 on success, -1 on failure with safe timing kept
+ **************************************************************
+ */
+
+int lcdCalibrate( LCD *lcd, int margin )
+{
+  unsigned char saved[ LCD_LINE_LENGTH ];
+  int result;
+
+  if ( lcd->RW < 0 || lcd->transportWrite != lcdParallelWrite || lcd->queue )
+  {
+    printf( "Failed: lcd calibration needs a parallel lcd with RW wired, outside async mode\n" );
+    return -1;
+  }
+
+  memcpy( saved, lcd->ddram, sizeof( saved ) );
+
+  result = jakesteringCalibrate( &lcd->timing, &safeTiming, lcdCalibrationTest, lcd, margin );
+
+  sendInstruction( lcd, LCD_DDRAM );
+
+  for ( int i = 0; i < LCD_LINE_LENGTH; i++ )
+  {
+    sendData( lcd, saved[ i ] );
+  }
+
+  return result;
+}
+
+/*
+ * Move the cursor
+ *
+ * Parameters:
+ *  x: move horizontally this amount
+ *  y: move vertically this amount
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdPosition( LCD *lcd, int x, int y )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_POSITION, x, y, 0 );
+    return;
+  }
+
+  if ( ( x > lcd->cols ) || ( x < 0 ) )
+  {
+    return;
+  }
+
+  if ( ( y > lcd->rows ) || ( y < 0 ) )
+  {
+    return;
+  }
+
+  sendInstruction( lcd, LCD_DDRAM | lcdCellAddress( lcd, x, y ) );
+
+  lcd->cx = x;
+  lcd->cy = y;
+}
+
+/* 
+ * Print a char to the lcd
+ *
+ * Parameters:
+ *  lcd      : lcd to print to  
+ *  character: char
+ *  
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdPutChar( LCD *lcd, unsigned char character )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_PUTCHAR, 0, 0, character );
+    return;
+  }
+
+  if ( lcd->address != lcdCellAddress( lcd, lcd->cx, lcd->cy ) ) //lcdFlush may have moved the address counter
+  {
+    lcdPosition( lcd, lcd->cx, lcd->cy );
+  }
+
+  lcd->screen[ lcd->cy ][ lcd->cx ] = character;
+  sendData( lcd, character );
+  
+  if ( ++lcd->cx == lcd->cols )
+  {
+    lcd->cx = 0;
+    
+    if ( ++lcd->cy == lcd->rows )
+    {
+      lcd->cy = 0;
+    }
+
+    lcdPosition( lcd, lcd->cx, lcd->cy );
+  }
+}
+
+/* 
+ * Print a string to the lcd
+ *
+ * Parameters:
+ *  lcd   : lcd to print to  
+ *  string: string
+ *  
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdPuts( LCD *lcd, const char* string )
+{
+  lcdBatchBegin( lcd );
+
+  while ( *string )
+  {
+    lcdPutChar( lcd, *string++ );
+  }
+
+  lcdBatchEnd( lcd );
+}
+
+/* 
+ * Print a formated string to the lcd
+ *
+ * Parameters:
+ *  lcd   : lcd to print to  
+ *  string: formated string
+ *  
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdPrintf( LCD *lcd, const char *string, ... )
+{
+  char buffer[ 1024 ];
+  va_list args;
+
+  va_start( args, string );
+  vsnprintf( buffer, sizeof( buffer ), string, args );
+  va_end( args );
+
+  lcdPuts( lcd, buffer );
+}
+
+/*
+ * Clears the lcd
+ *
+ * Parameters:
+ *  lcd: screen to clear
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdClear( LCD *lcd )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_CLEAR, 0, 0, 0 ); //becomes a diff against the shadow, no 1.52 ms clear
+    return;
+  }
+
+  memset( lcd->screen, ' ', sizeof( lcd->screen ) );
+  sendInstruction( lcd, LCD_CLEAR );
+  sendInstruction( lcd, LCD_HOME );
+  lcd->cx = 0;
+  lcd->cy = 0;
+}
+
+/*
+ * Send a display control instruction, or queue it in async mode
+ *
+ * Parameters:
+ *  lcd        : screen
+ *  instruction: LCD_CONTROL instruction
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdControl( LCD *lcd, const int instruction )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_INSTRUCTION, 0, 0, instruction );
+    return;
+  }
+
+  sendInstruction( lcd, instruction );
+}
+
+/*
+ * Set the display on/off 
+ *
+ * Parameters:
+ *  lcd  : screen
+ *  value: 1 = on | 0 = off
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdDisplay( LCD *lcd, int value )
+{
+  if ( value )
+  {
+    lcdControl( lcd, LCD_CONTROL | D_CONTROL );
+    return;
+  }
+
+  else
+  {
+    lcdControl( lcd, LCD_CONTROL );
+    return;
+  }
+}
+
+/*
+ * Turn off/on cursor
+ *
+ * Parameters:
+ *  lcd  : screen to set cursor
+ *  value: 1 = set cursor on | 0 = set cursor off
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdCursor( LCD *lcd, int value )
+{
+  if ( value )
+  {
+    lcdControl( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL );
+    return;
+  }
+
+  else
+  {
+    lcdControl( lcd, LCD_CONTROL | D_CONTROL );
+    return;
+  }
+}
+
+/*
+ * Set the cursor to blink
+ *
+ * Parameters:
+ *  lcd  : screen with cursor to blink
+ *  value: 1 = on | 0 = off
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdCursorBlink( LCD *lcd, int value )
+{
+  if ( value )
+  {
+    lcdControl( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL | B_CONTROL );
+    return;
+  }
+
+  else
+  {
+    lcdControl( lcd, LCD_CONTROL | D_CONTROL | C_CONTROL );
+    return;
+  }
+}
+
+/*
+ * Write the backlight bit to the PCF8574 port
+ *
+ * Parameters:
+ *  lcd  : lcd with the backlight
+ *  value: 1 = on | 0 = off
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdSetBacklight( LCD *lcd, const int value )
+{
+  lcd->backlight = value;
+
+  if ( lcd->i2cFd < 0 )
+  {
+    return;
+  }
+
+  if ( lcd->i2cLength == LCD_I2C_BUFFER )
+  {
+    lcdI2cFlush( lcd );
+  }
+
+  lcd->i2cBuffer[ lcd->i2cLength++ ] = value ? LCD_I2C_BACKLIGHT : 0;
+  lcdI2cFlush( lcd );
+}
+
+/*
+ * Turn the backlight on/off. Only an i2c backpack can switch it.
+ *
+ * Parameters:
+ *  lcd  : lcd with the backlight
+ *  value: 1 = on | 0 = off
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdBacklight( LCD *lcd, int value )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_BACKLIGHT, 0, 0, value );
+    return;
+  }
+
+  lcdSetBacklight( lcd, value );
+}
+
+/*
+ * Write a custom character into CGRAM
+ *
+ * Parameters:
+ *  lcd   : lcd to load
+ *  slot  : CGRAM slot 0-7
+ *  bitmap: 8 rows of 5 pixels, row 0 in the low byte
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdLoadGlyph( LCD *lcd, int slot, uint64_t bitmap )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_GLYPH, ( uint32_t )bitmap, ( uint32_t )( bitmap >> 32 ), slot );
+    return;
+  }
+
+  lcdBatchBegin( lcd );
+  sendInstruction( lcd, LCD_CGRAM | ( ( slot & 0b111 ) << 3 ) );
+
+  for ( int row = 0; row < 8; row++ )
+  {
+    sendData( lcd, ( bitmap >> ( row * 8 ) ) & 0b11111 );
+  }
+
+  lcdBatchEnd( lcd );
+}
+
+/*
+ * Clear the virtual screen. Nothing is sent until lcdFlush.
+ *
+ * Parameters:
+ *  lcd: screen to clear
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdScreenClear( LCD *lcd )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_CLEAR, -1, 0, 0 );
+    return;
+  }
+
+  memset( lcd->screen, ' ', sizeof( lcd->screen ) );
+}
+
+/*
+ * Put a char on the virtual screen
+ *
+ * Parameters:
+ *  lcd      : screen to write to
+ *  x        : column
+ *  y        : row
+ *  character: char
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdScreenPutChar( LCD *lcd, int x, int y, unsigned char character )
+{
+  if ( x < 0 || x >= lcd->cols || y < 0 || y >= lcd->rows )
+  {
+    return;
+  }
+
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_SCREEN_PUT, x, y, character );
+    return;
+  }
+
+  lcd->screen[ y ][ x ] = character;
+}
+
+/*
+ * Put a string on the virtual screen, clipped at the end of the row
+ *
+ * Parameters:
+ *  lcd   : screen to write to
+ *  x     : starting column
+ *  y     : row
+ *  string: string
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdScreenPuts( LCD *lcd, int x, int y, const char *string )
+{
+  while ( *string && x < lcd->cols )
+  {
+    lcdScreenPutChar( lcd, x++, y, *string++ );
+  }
+}
+
+/*
+ * Put a formated string on the virtual screen, clipped at the end of the row
+ *
+ * Parameters:
+ *  lcd   : screen to write to
+ *  x     : starting column
+ *  y     : row
+ *  string: formated string
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdScreenPrintf( LCD *lcd, int x, int y, const char *string, ... )
+{
+  char buffer[ LCD_MAX_COLS + 1 ];
+  va_list args;
+
+  va_start( args, string );
+  vsnprintf( buffer, sizeof( buffer ), string, args );
+  va_end( args );
+
+  lcdScreenPuts( lcd, x, y, buffer );
+}
+
+/*
+ * Send the cells of the virtual screen that differ from the shadow DDRAM.
+ * Changed cells are grouped into runs so each run costs one address set,
+ * and runs split by a single unchanged cell are merged since rewriting it
+ * costs no more than a second address set. A shifted row that wraps from
+ * 0x27 back to 0x00 needs a second set there, the counter goes on to 0x40.
+ *
+ * Parameters:
+ *  lcd: screen to update
+ *
+ * Return:
+ *  number of bus writes made
+ **************************************************************
+ */
+
+static int lcdFlushScreen( LCD *lcd )
+{
+  int writes = 0;
+  int decrement = !lcd->increment;
+
+  lcdBatchBegin( lcd );
+
+  if ( decrement )
+  {
+    sendInstruction( lcd, LCD_ENTRY | ID_ENTRY ); //runs are written left to right
+  }
+
+  for ( int y = 0; y < lcd->rows; y++ )
+  {
+    int x = 0;
+
+    while ( x < lcd->cols )
+    {
+      if ( lcd->screen[ y ][ x ] == lcd->ddram[ lcdCellAddress( lcd, x, y ) ] )
+      {
+        x++;
+        continue;
+      }
+
+      int end = x;
+      for ( int i = x + 1; i < lcd->cols && i - end <= 2; i++ )
+      {
+        if ( lcd->screen[ y ][ i ] != lcd->ddram[ lcdCellAddress( lcd, i, y ) ] )
+        {
+          end = i;
+        }
+      }
+
+      for ( ; x <= end; x++ )
+      {
+        if ( lcd->address != lcdCellAddress( lcd, x, y ) ) //start of the run, or a shifted row wrapping 0x27 to 0x00
+        {
+          sendInstruction( lcd, LCD_DDRAM | lcdCellAddress( lcd, x, y ) );
+          writes++;
+        }
+
+        sendData( lcd, lcd->screen[ y ][ x ] );
+        writes++;
+      }
+    }
+  }
+
+  if ( decrement )
+  {
+    sendInstruction( lcd, LCD_ENTRY );
+  }
+
+  lcdBatchEnd( lcd );
+
+  return writes;
+}
+
+/*
+ * Send the virtual screen to the lcd. In async mode the writer thread
+ * flushes on its own whenever its queue drains, so this does nothing.
+ *
+ * Parameters:
+ *  lcd: screen to update
+ *
+ * Return:
+ *  number of bus writes made
+ **************************************************************
+ */
+
+int lcdFlush( LCD *lcd )
+{
+  if ( lcd->queue )
+  {
+    return 0;
+  }
+
+  return lcdFlushScreen( lcd );
+}
+
+/*
+ * Write one DDRAM cell directly, visible or not, skipping it when the
+ * shadow already holds the character
+ *
+ * Parameters:
+ *  lcd      : lcd to write to
+ *  address  : DDRAM address
+ *  character: char
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdWriteDdram( LCD *lcd, const int address, const int character )
+{
+  if ( lcd->ddram[ address ] == character )
+  {
+    return;
+  }
+
+  lcdFlushScreen( lcd ); //pending text is meant for the cells as they are now
+
+  if ( lcd->address != address )
+  {
+    sendInstruction( lcd, LCD_DDRAM | address );
+  }
+
+  sendData( lcd, character );
+  lcdScreenSync( lcd );
+}
+
+/*
+ * Shift the whole display one cell with a single instruction and move the
+ * virtual screen along with it
+ *
+ * Parameters:
+ *  lcd      : lcd to shift
+ *  direction: 1 = text moves left | -1 = right | 0 = undo every shift
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdShiftDisplay( LCD *lcd, const int direction )
+{
+  lcdFlushScreen( lcd );
+
+  if ( direction == 0 )
+  {
+    sendInstruction( lcd, LCD_HOME );
+  }
+
+  else
+  {
+    sendInstruction( lcd, LCD_CURSOR_SHIFT | LCD_SC_SHIFT | ( ( direction < 0 ) ? LCD_RL_SHIFT : 0 ) );
+  }
+
+  lcdScreenSync( lcd );
+}
+
+/*
+ * Load a whole DDRAM line for scrolling. Each line holds 40 cells while
+ * only cols of them are shown, so text longer than the display is written
+ * once and brought into view with lcdMarqueeStep. On a 4 row display
+ * line 0 holds rows 0 and 2, line 1 holds rows 1 and 3.
+ *
+ * Parameters:
+ *  lcd   : lcd to load
+ *  line  : DDRAM line, 0 or 1
+ *  string: text, padded with spaces or cut to 40 chars
+ *
+ * Return:
+ *  0 on success, -1 on a bad line
+ **************************************************************
+ */
+
+int lcdMarqueeLoad( LCD *lcd, int line, const char *string )
+{
+  if ( line < 0 || line > 1 )
+  {
+    printf( "Failed: lcd line %d does not exist\n", line );
+    return -1;
+  }
+
+  lcdBatchBegin( lcd );
+
+  for ( int i = 0; i < LCD_LINE_LENGTH; i++ )
+  {
+    unsigned char character = *string ? *string++ : ' ';
+
+    if ( lcd->queue )
+    {
+      lcdEnqueue( lcd, LCD_CMD_DDRAM, ( line << 6 ) | i, 0, character );
+    }
+
+    else
+    {
+      lcdWriteDdram( lcd, ( line << 6 ) | i, character );
+    }
+  }
+
+  lcdBatchEnd( lcd );
+
+  return 0;
+}
+
+/*
+ * Scroll every line one cell. This is one bus write however long the text
+ * is; the lines can't be shifted separately.
+ *
+ * Parameters:
+ *  lcd      : lcd to scroll
+ *  direction: 1 = text moves left | -1 = right | 0 = back to unshifted
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdMarqueeStep( LCD *lcd, int direction )
+{
+  if ( lcd->queue )
+  {
+    lcdEnqueue( lcd, LCD_CMD_SHIFT, 0, 0, direction );
+    return;
+  }
+
+  lcdShiftDisplay( lcd, direction );
+}
+
+/*
+ * Start scrolling at a fixed rate. Steps are taken by lcdMarqueeTick, so
+ * the bus is only touched from the caller's loop.
+ *
+ * Parameters:
+ *  lcd      : lcd to scroll
+ *  direction: 1 = text moves left | -1 = right
+ *  periodMs : ms between steps
+ *  nowMs    : current time, from millis()
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdMarqueeStart( LCD *lcd, int direction, unsigned int periodMs, uint64_t nowMs )
+{
+  lcd->marqueeDirection = ( direction < 0 ) ? -1 : 1;
+  lcd->marqueePeriod = periodMs;
+  lcd->marqueeNext = nowMs + periodMs;
+}
+
+/*
+ * Take a marquee step when one is due. Missed steps are dropped rather
+ * than sent in a burst.
+ *
+ * Parameters:
+ *  lcd  : lcd to scroll
+ *  nowMs: current time, from millis()
+ *
+ * Return:
+ *  1 if the display was shifted, otherwise 0
+ **************************************************************
+ */
+
+int lcdMarqueeTick( LCD *lcd, uint64_t nowMs )
+{
+  if ( lcd->marqueeDirection == 0 || nowMs < lcd->marqueeNext )
+  {
+    return 0;
+  }
+
+  lcdMarqueeStep( lcd, lcd->marqueeDirection );
+
+  lcd->marqueeNext += lcd->marqueePeriod;
+
+  if ( lcd->marqueeNext <= nowMs )
+  {
+    lcd->marqueeNext = nowMs + lcd->marqueePeriod;
+  }
+
+  return 1;
+}
+
+/*
+ * Stop scrolling
+ *
+ * Parameters:
+ *  lcd : lcd to stop
+ *  home: 1 = undo the shift | 0 = leave the text where it is
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdMarqueeStop( LCD *lcd, int home )
+{
+  lcd->marqueeDirection = 0;
+
+  if ( home )
+  {
+    lcdMarqueeStep( lcd, 0 );
+  }
+}
+
+/*
+ * Apply one queued command. Text only lands in the virtual screen, so text
+ * rewritten before the queue drains never reaches the bus.
+ *
+ * Parameters:
+ *  lcd    : lcd owned by the writer
+ *  command: command to apply
+ *
+ * Return:
+ *  1 when the writer should stop, otherwise 0
+ **************************************************************
+ */
+
+static int lcdApply( LCD *lcd, LcdCommand *command )
+{
+  LcdQueue *queue = lcd->queue;
+
+  switch ( command->type )
+  {
+    case LCD_CMD_PUTCHAR:
+      lcd->screen[ lcd->cy ][ lcd->cx ] = command->value;
+
+      if ( ++lcd->cx == lcd->cols )
+      {
+        lcd->cx = 0;
+
+        if ( ++lcd->cy == lcd->rows )
+        {
+          lcd->cy = 0;
+        }
+      }
+      break;
+
+    case LCD_CMD_POSITION:
+      if ( command->x >= 0 && command->x < lcd->cols && command->y >= 0 && command->y < lcd->rows )
+      {
+        lcd->cx = command->x;
+        lcd->cy = command->y;
+      }
+      break;
+
+    case LCD_CMD_CLEAR:
+      memset( lcd->screen, ' ', sizeof( lcd->screen ) );
+
+      if ( command->x == 0 ) //lcdClear also homes the cursor, lcdScreenClear does not
+      {
+        lcd->cx = 0;
+        lcd->cy = 0;
+      }
+      break;
+
+    case LCD_CMD_SCREEN_PUT:
+      lcd->screen[ command->y ][ command->x ] = command->value;
+      break;
+
+    case LCD_CMD_INSTRUCTION:
+      lcdFlushScreen( lcd );
+      sendInstruction( lcd, command->value );
+      break;
+
+    case LCD_CMD_GLYPH:
+      lcdFlushScreen( lcd ); //cells already showing the slot keep their old bitmap until now
+      sendInstruction( lcd, LCD_CGRAM | ( ( command->value & 0b111 ) << 3 ) );
+
+      for ( int row = 0; row < 8; row++ )
+      {
+        uint32_t half = ( row < 4 ) ? ( uint32_t )command->x : ( uint32_t )command->y;
+        sendData( lcd, ( half >> ( ( row % 4 ) * 8 ) ) & 0b11111 );
+      }
+      break;
+
+    case LCD_CMD_SHIFT:
+      lcdShiftDisplay( lcd, command->value );
+      break;
+
+    case LCD_CMD_DDRAM:
+      lcdWriteDdram( lcd, command->x, command->value );
+      break;
+
+    case LCD_CMD_BACKLIGHT:
+      lcdFlushScreen( lcd );
+      lcdSetBacklight( lcd, command->value );
+      break;
+
+    case LCD_CMD_FENCE:
+      lcdFlushScreen( lcd );
+      pthread_mutex_lock( &queue->fenceLock );
+        if ( ( int )( command->value - queue->fenceDone ) > 0 ) //tickets can be queued out of order, never move back
+        {
+          queue->fenceDone = command->value;
+        }
+
+        pthread_cond_broadcast( &queue->fenceCond );
+      pthread_mutex_unlock( &queue->fenceLock );
+      break;
+
+    case LCD_CMD_STOP:
+      lcdFlushScreen( lcd );
+      return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Writer thread. Owns the bus while async mode is on, applies queued
+ * commands and flushes the virtual screen whenever the queue runs dry.
+ *
+ * Parameters:
+ *  arg: the LCD
+ *
+ * Return:
+ *  NULL
+ **************************************************************
+ */
+
+static void *lcdWriter( void *arg )
+{
+  LCD *lcd = ( LCD* )arg;
+  LcdQueue *queue = lcd->queue;
+
+  for (;;)
+  {
+    sem_wait( &queue->wake );
+
+    for (;;)
+    {
+      LcdCommand *command = &queue->commands[ queue->dequeue & ( LCD_QUEUE_SIZE - 1 ) ];
+
+      if ( __atomic_load_n( &command->sequence, __ATOMIC_ACQUIRE ) != queue->dequeue + 1 )
+      {
+        break;
+      }
+
+      int stop = lcdApply( lcd, command );
+
+      __atomic_store_n( &command->sequence, queue->dequeue + LCD_QUEUE_SIZE, __ATOMIC_RELEASE );
+      queue->dequeue++;
+
+      if ( stop )
+      {
+        return NULL;
+      }
+    }
+
+    lcdFlushScreen( lcd );
+
+    if ( ( lcd->control & ( C_CONTROL | B_CONTROL ) ) && lcd->address != lcdCellAddress( lcd, lcd->cx, lcd->cy ) )
+    {
+      sendInstruction( lcd, LCD_DDRAM | lcdCellAddress( lcd, lcd->cx, lcd->cy ) ); //leave a visible cursor where the app put it
+    }
+  }
+}
+
+/*
+ * Switch the lcd to async mode. lcdPutChar, lcdPuts, lcdPrintf,
+ * lcdPosition, lcdClear, the display controls and the lcdScreen calls are
+ * queued and return at once; a writer thread owns the bus from then on.
+ *
+ * Parameters:
+ *  lcd: lcd to switch
+ *
+ * Return:
+ *  0 on success, -1 on failure
+ **************************************************************
+ */
+
+int lcdAsyncStart( LCD *lcd )
+{
+  LcdQueue *queue;
+
+  if ( lcd->queue )
+  {
+    return 0;
+  }
+
+  queue = ( LcdQueue* )calloc( 1, sizeof( LcdQueue ) );
+
+  for ( unsigned int i = 0; i < LCD_QUEUE_SIZE; i++ )
+  {
+    queue->commands[ i ].sequence = i;
+  }
+
+  sem_init( &queue->wake, 0, 0 );
+  pthread_mutex_init( &queue->fenceLock, NULL );
+  pthread_cond_init( &queue->fenceCond, NULL );
+
+  lcd->queue = queue;
+
+  if ( pthread_create( &queue->writer, NULL, lcdWriter, lcd ) != 0 )
+  {
+    printf( "Failed to create lcd writer thread\n" );
+    lcd->queue = NULL;
+    sem_destroy( &queue->wake );
+    free( queue );
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Block until everything queued before this call is on the display
+ *
+ * Parameters:
+ *  lcd: lcd in async mode
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdAsyncFence( LCD *lcd )
+{
+  LcdQueue *queue = lcd->queue;
+
+  if ( queue == NULL )
+  {
+    return;
+  }
+
+  unsigned int ticket = __atomic_add_fetch( &queue->fenceIssued, 1, __ATOMIC_RELAXED );
+
+  lcdEnqueue( lcd, LCD_CMD_FENCE, 0, 0, ticket );
+
+  pthread_mutex_lock( &queue->fenceLock );
+    while ( ( int )( queue->fenceDone - ticket ) < 0 )
+    {
+      pthread_cond_wait( &queue->fenceCond, &queue->fenceLock );
+    }
+  pthread_mutex_unlock( &queue->fenceLock );
+}
+
+/*
+ * Drain the queue, stop the writer thread and go back to synchronous calls
+ *
+ * Parameters:
+ *  lcd: lcd in async mode
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdAsyncStop( LCD *lcd )
+{
+  LcdQueue *queue = lcd->queue;
+
+  if ( queue == NULL )
+  {
+    return;
+  }
+
+  lcdEnqueue( lcd, LCD_CMD_STOP, 0, 0, 0 );
+  pthread_join( queue->writer, NULL );
+
+  lcd->queue = NULL;
+
+  sem_destroy( &queue->wake );
+  pthread_mutex_destroy( &queue->fenceLock );
+  pthread_cond_destroy( &queue->fenceCond );
+  free( queue );
+}
+
+/*
+ * Allocate an lcd with empty shadows and no transport
+ *
+ * Parameters:
+ *  rows: rows of the display
+ *  cols: columns of the display
+ *
+ * Return:
+ *  LCD : with every field but the wiring set
+ **************************************************************
+ */
+
+static LCD* lcdAlloc( int rows, int cols )
+{
+  LCD *lcd = ( LCD* )malloc( sizeof( LCD ) );
+
+  lcd->RS  = -1;
+  lcd->RW  = -1;
+  lcd->E   = -1;
+  lcd->DB0 = -1;
+  lcd->DB1 = -1;
+  lcd->DB2 = -1;
+  lcd->DB3 = -1;
+  lcd->DB4 = -1;
+  lcd->DB5 = -1;
+  lcd->DB6 = -1;
+  lcd->DB7 = -1;
+
+  lcd->rows = rows;
+  lcd->cols = cols;
+  
+  lcd->cx = 0;
+  lcd->cy = 0;
+
+  lcd->timing = safeTiming;
+
+  lcd->transportWrite = NULL;
+  lcd->transportFlush = NULL;
+  lcd->batch = 0;
+  lcd->bus = NULL;
+  lcd->busSlot = -1;
+  lcd->i2cFd = -1;
+  lcd->backlight = 0;
+  lcd->i2cLength = 0;
+
+  memset( lcd->screen, ' ', sizeof( lcd->screen ) );
+  memset( lcd->ddram, ' ', sizeof( lcd->ddram ) );
+  lcd->address = -1;
+  lcd->increment = 1;
+  lcd->shift = 0;
+  lcd->control = 0;
+  lcd->queue = NULL;
+
+  memset( lcd->glyphs, 0, sizeof( lcd->glyphs ) );
+  memset( lcd->glyphUsed, 0, sizeof( lcd->glyphUsed ) );
+  lcd->glyphClock = 0;
+
+  lcd->marqueeDirection = 0;
+  lcd->marqueePeriod = 0;
+  lcd->marqueeNext = 0;
+
+  return lcd;
+}
+
+/*
+ * Finish initialization once the function set is sent
+ *
+ * Parameters:
+ *  lcd: lcd in its final bus mode
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdStart( LCD *lcd )
+{
+  sendInstruction( lcd, 0b00001100 ); //Set display on, cursor on, cursor blinking off
+  sendInstruction( lcd, 0b00000110 ); //Set entry mode, increment address
+  sendInstruction( lcd, LCD_CLEAR );  //Start the shadow DDRAM from a known state
+}
+
+/* 
+ * Initialize the lcd with RW tied to ground. Every write waits out the
+ * worst case execution time.
+ *
+ * Parameters:
+ *  RS    : register select
+ *  E     : enable
+ *  DB0-7 : data lines
+ * 
+ * Return:
+ *  LCD : that has been initialized
+ **************************************************************
+ */
+
+LCD* initLcd( int rows, int cols, int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7 )
+{
+  return initLcdRW( rows, cols, RS, -1, E, DB0, DB1, DB2, DB3, DB4, DB5, DB6, DB7 );
+}
+
+/* 
+ * Initialize the lcd with the RW line wired, so writes wait on the busy
+ * flag instead of a fixed delay
+ *
+ * Parameters:
+ *  RS    : register select
+ *  RW    : read/write, -1 when tied to ground
+ *  E     : enable
+ *  DB0-7 : data lines
+ * 
+ * Return:
+ *  LCD : that has been initialized
+ **************************************************************
+ */
+
+LCD* initLcdRW( int rows, int cols, int RS, int RW, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7 )
+{
+  LCD *lcd = lcdAlloc( rows, cols );
+  
+  lcd->RS  =  RS;
+  lcd->RW  =  -1; //the busy flag can't be read until the function set is done
+  lcd->E   =   E;
+  lcd->DB0 = DB0;
+  lcd->DB1 = DB1;
+  lcd->DB2 = DB2;
+  lcd->DB3 = DB3;
+  lcd->DB4 = DB4;
+  lcd->DB5 = DB5;
+  lcd->DB6 = DB6;
+  lcd->DB7 = DB7;
+
+  lcd->transportWrite = lcdParallelWrite;
+
+  pinMode( lcd->RS , OUTPUT );
+  pinMode( lcd->E  , OUTPUT );
+  lcdBusMode( lcd, OUTPUT );
+
+  if ( RW >= 0 )
+  {
+    pinMode( RW, OUTPUT );
+    digitalWrite( RW, LOW );
+  }
+
+  digitalWrite( lcd->RS, HIGH );
+  digitalWrite( lcd->E , LOW  );
+
+  sendInstruction( lcd, 0b00111000 ); //Set 8-bit operation, 2-line mode, 5x8 character font
+  
+  lcd->RW = RW;
+
+  lcdStart( lcd );
+
+  return lcd;
+}
+
+/* 
+ * Initialize an lcd behind a PCF8574 i2c backpack
+ *
+ * Parameters:
+ *  rows   : rows of the display
+ *  cols   : columns of the display
+ *  device : i2c bus, e.g. /dev/i2c-1
+ *  address: backpack address, usually 0x27 or 0x3F
+ * 
+ * Return:
+ *  LCD : that has been initialized, NULL on failure
+ **************************************************************
+ */
+
+LCD* initLcdI2c( int rows, int cols, const char *device, int address )
+{
+  int fd = open( device, O_RDWR );
+
+  if ( fd < 0 )
+  {
+    printf( "Failed: to open %s: %s\n", device, strerror( errno ) );
+    return NULL;
+  }
+
+  if ( ioctl( fd, I2C_SLAVE, address ) < 0 )
+  {
+    printf( "Failed: to select i2c address 0x%02x: %s\n", address, strerror( errno ) );
+    close( fd );
+    return NULL;
+  }
+
+  return initLcdI2cFd( rows, cols, fd );
+}
+
+/* 
+ * Initialize an lcd behind a PCF8574 on an already open descriptor. Each
+ * write() is one i2c transfer of port values, so a pipe or socket works
+ * as a fake backpack.
+ *
+ * Parameters:
+ *  rows: rows of the display
+ *  cols: columns of the display
+ *  fd  : descriptor addressed to the backpack, owned by the lcd
+ * 
+ * Return:
+ *  LCD : that has been initialized
+ **************************************************************
+ */
+
+LCD* initLcdI2cFd( int rows, int cols, int fd )
+{
+  LCD *lcd = lcdAlloc( rows, cols );
+
+  lcd->i2cFd = fd;
+  lcd->backlight = 1;
+  lcd->transportWrite = lcdI2cWrite;
+  lcd->transportFlush = lcdI2cFlush;
+
+  lcdI2cNibble( lcd, 0x30 | LCD_I2C_BACKLIGHT ); //Reset to 8-bit operation whatever state it was left in
+  lcdI2cFlush( lcd );
+  delayMicro( 4100 );
+  lcdI2cNibble( lcd, 0x30 | LCD_I2C_BACKLIGHT );
+  lcdI2cFlush( lcd );
+  delayMicro( 100 );
+  lcdI2cNibble( lcd, 0x30 | LCD_I2C_BACKLIGHT );
+  lcdI2cNibble( lcd, 0x20 | LCD_I2C_BACKLIGHT ); //Switch to 4-bit operation
+  lcdI2cFlush( lcd );
+  delayMicro( LCD_EXEC_MICRO );
+
+  sendInstruction( lcd, 0b00101000 ); //Set 4-bit operation, 2-line mode, 5x8 character font
+
+  lcdStart( lcd );
+
+  return lcd;
+}
+
+/*
+ * Stop async mode, close the i2c descriptor and free the lcd
+ *
+ * Parameters:
+ *  lcd: lcd to close
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void closeLcd( LCD *lcd )
+{
+  lcdAsyncStop( lcd );
+
+  if ( lcd->transportFlush )
+  {
+    lcd->transportFlush( lcd );
+  }
+
+  if ( lcd->i2cFd >= 0 )
+  {
+    close( lcd->i2cFd );
+  }
+
+  free( lcd );
 }
 
@@ -0,0 +1,436 @@
+/*
+ * lcd128Font.c:
+ *  Bitmap fonts drawn into the LCD128 graphics buffer
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "jakestering.h"
+#include "lcd128x64.h"
+#include "lcd128Font.h"
+
+static const uint8_t font5x7Columns[] =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, //  
+  0x00, 0x00, 0x5F, 0x00, 0x00, // !
+  0x00, 0x07, 0x00, 0x07, 0x00, // "
+  0x14, 0x7F, 0x14, 0x7F, 0x14, // #
+  0x24, 0x2A, 0x7F, 0x2A, 0x12, // $
+  0x23, 0x13, 0x08, 0x64, 0x62, // %
+  0x36, 0x49, 0x55, 0x22, 0x50, // &
+  0x00, 0x05, 0x03, 0x00, 0x00, // '
+  0x00, 0x1C, 0x22, 0x41, 0x00, // (
+  0x00, 0x41, 0x22, 0x1C, 0x00, // )
+  0x14, 0x08, 0x3E, 0x08, 0x14, // *
+  0x08, 0x08, 0x3E, 0x08, 0x08, // +
+  0x00, 0x50, 0x30, 0x00, 0x00, // ,
+  0x08, 0x08, 0x08, 0x08, 0x08, // -
+  0x00, 0x60, 0x60, 0x00, 0x00, // .
+  0x20, 0x10, 0x08, 0x04, 0x02, // /
+  0x3E, 0x51, 0x49, 0x45, 0x3E, // 0
+  0x00, 0x42, 0x7F, 0x40, 0x00, // 1
+  0x42, 0x61, 0x51, 0x49, 0x46, // 2
+  0x21, 0x41, 0x45, 0x4B, 0x31, // 3
+  0x18, 0x14, 0x12, 0x7F, 0x10, // 4
+  0x27, 0x45, 0x45, 0x45, 0x39, // 5
+  0x3C, 0x4A, 0x49, 0x49, 0x30, // 6
+  0x01, 0x71, 0x09, 0x05, 0x03, // 7
+  0x36, 0x49, 0x49, 0x49, 0x36, // 8
+  0x06, 0x49, 0x49, 0x29, 0x1E, // 9
+  0x00, 0x36, 0x36, 0x00, 0x00, // :
+  0x00, 0x56, 0x36, 0x00, 0x00, // ;
+  0x08, 0x14, 0x22, 0x41, 0x00, // <
+  0x14, 0x14, 0x14, 0x14, 0x14, // =
+  0x00, 0x41, 0x22, 0x14, 0x08, // >
+  0x02, 0x01, 0x51, 0x09, 0x06, // ?
+  0x32, 0x49, 0x79, 0x41, 0x3E, // @
+  0x7E, 0x11, 0x11, 0x11, 0x7E, // A
+  0x7F, 0x49, 0x49, 0x49, 0x36, // B
+  0x3E, 0x41, 0x41, 0x41, 0x22, // C
+  0x7F, 0x41, 0x41, 0x22, 0x1C, // D
+  0x7F, 0x49, 0x49, 0x49, 0x41, // E
+  0x7F, 0x09, 0x09, 0x01, 0x01, // F
+  0x3E, 0x41, 0x41, 0x51, 0x32, // G
+  0x7F, 0x08, 0x08, 0x08, 0x7F, // H
+  0x00, 0x41, 0x7F, 0x41, 0x00, // I
+  0x20, 0x40, 0x41, 0x3F, 0x01, // J
+  0x7F, 0x08, 0x14, 0x22, 0x41, // K
+  0x7F, 0x40, 0x40, 0x40, 0x40, // L
+  0x7F, 0x02, 0x04, 0x02, 0x7F, // M
+  0x7F, 0x04, 0x08, 0x10, 0x7F, // N
+  0x3E, 0x41, 0x41, 0x41, 0x3E, // O
+  0x7F, 0x09, 0x09, 0x09, 0x06, // P
+  0x3E, 0x41, 0x51, 0x21, 0x5E, // Q
+  0x7F, 0x09, 0x19, 0x29, 0x46, // R
+  0x46, 0x49, 0x49, 0x49, 0x31, // S
+  0x01, 0x01, 0x7F, 0x01, 0x01, // T
+  0x3F, 0x40, 0x40, 0x40, 0x3F, // U
+  0x1F, 0x20, 0x40, 0x20, 0x1F, // V
+  0x7F, 0x20, 0x18, 0x20, 0x7F, // W
+  0x63, 0x14, 0x08, 0x14, 0x63, // X
+  0x03, 0x04, 0x78, 0x04, 0x03, // Y
+  0x61, 0x51, 0x49, 0x45, 0x43, // Z
+  0x00, 0x7F, 0x41, 0x41, 0x00, // [
+  0x02, 0x04, 0x08, 0x10, 0x20, // backslash
+  0x00, 0x41, 0x41, 0x7F, 0x00, // ]
+  0x04, 0x02, 0x01, 0x02, 0x04, // ^
+  0x40, 0x40, 0x40, 0x40, 0x40, // _
+  0x00, 0x01, 0x02, 0x04, 0x00, // `
+  0x20, 0x54, 0x54, 0x54, 0x78, // a
+  0x7F, 0x48, 0x44, 0x44, 0x38, // b
+  0x38, 0x44, 0x44, 0x44, 0x20, // c
+  0x38, 0x44, 0x44, 0x48, 0x7F, // d
+  0x38, 0x54, 0x54, 0x54, 0x18, // e
+  0x08, 0x7E, 0x09, 0x01, 0x02, // f
+  0x0C, 0x52, 0x52, 0x52, 0x3E, // g
+  0x7F, 0x08, 0x04, 0x04, 0x78, // h
+  0x00, 0x44, 0x7D, 0x40, 0x00, // i
+  0x20, 0x40, 0x44, 0x3D, 0x00, // j
+  0x7F, 0x10, 0x28, 0x44, 0x00, // k
+  0x00, 0x41, 0x7F, 0x40, 0x00, // l
+  0x7C, 0x04, 0x18, 0x04, 0x78, // m
+  0x7C, 0x08, 0x04, 0x04, 0x78, // n
+  0x38, 0x44, 0x44, 0x44, 0x38, // o
+  0x7C, 0x14, 0x14, 0x14, 0x08, // p
+  0x08, 0x14, 0x14, 0x18, 0x7C, // q
+  0x7C, 0x08, 0x04, 0x04, 0x08, // r
+  0x48, 0x54, 0x54, 0x54, 0x20, // s
+  0x04, 0x3F, 0x44, 0x40, 0x20, // t
+  0x3C, 0x40, 0x40, 0x20, 0x7C, // u
+  0x1C, 0x20, 0x40, 0x20, 0x1C, // v
+  0x3C, 0x40, 0x30, 0x40, 0x3C, // w
+  0x44, 0x28, 0x10, 0x28, 0x44, // x
+  0x0C, 0x50, 0x50, 0x50, 0x3C, // y
+  0x44, 0x64, 0x54, 0x4C, 0x44, // z
+  0x00, 0x08, 0x36, 0x41, 0x00, // {
+  0x00, 0x00, 0x7F, 0x00, 0x00, // |
+  0x00, 0x41, 0x36, 0x08, 0x00, // }
+  0x08, 0x04, 0x08, 0x10, 0x08, // ~
+};
+
+const Lcd128Font lcd128Font5x7 = { font5x7Columns, 0x20, 95, 5, 7, 1 };
+
+typedef struct _lcd128GlyphEntry
+{
+  const Lcd128Font *font; // NULL when the entry is empty
+  int code;
+  int scale;
+  int proportional;
+  int columns; // font columns kept, before scaling
+  uint8_t bits[ 8 * LCD128_FONT_MAX_SCALE * LCD128_FONT_MAX_SCALE ];
+  Lcd128Bitmap bitmap;
+} Lcd128GlyphEntry;
+
+static Lcd128GlyphEntry glyphCache[ LCD128_FONT_CACHE ];
+
+static uint32_t spread[ LCD128_FONT_MAX_SCALE + 1 ][ 256 ]; //each bit of a byte repeated scale times, MSB first
+
+/*
+ * Fill the bit spreading tables, once
+ *
+ * Parameters:
+ *  void
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128FontSpreadInit( void )
+{
+  static int ready = 0;
+
+  if ( ready )
+  {
+    return;
+  }
+
+  for ( int scale = 1; scale <= LCD128_FONT_MAX_SCALE; scale++ )
+  {
+    for ( int byte = 0; byte < 256; byte++ )
+    {
+      uint32_t bits = 0;
+
+      for ( int bit = 7; bit >= 0; bit-- )
+      {
+        bits = ( bits << scale ) | ( ( byte >> bit ) & 1 ? ( 1u << scale ) - 1 : 0 );
+      }
+
+      spread[ scale ][ byte ] = bits;
+    }
+  }
+
+  ready = 1;
+}
+
+/*
+ * Get the bitmap of a glyph at a scale, from the cache or built into
+ * it: columns turned into MSB-left rows, each row spread to scale times
+ * its width by table and repeated scale times down.
+ *
+ * Parameters:
+ *  font        : font holding the glyph
+ *  code        : character, inside the font
+ *  scale       : 1 to LCD128_FONT_MAX_SCALE
+ *  proportional: 1 = blank columns either side dropped | 0 = full width
+ *
+ * Return:
+ *  the cached glyph
+ **************************************************************
+ */
+
+static const Lcd128GlyphEntry* lcd128FontGlyph( const Lcd128Font *font, int code, int scale, int proportional )
+{
+  Lcd128GlyphEntry *entry = &glyphCache[ ( code * 4 + scale + proportional * 2 * LCD128_FONT_MAX_SCALE ) & ( LCD128_FONT_CACHE - 1 ) ];
+
+  if ( entry->font == font && entry->code == code && entry->scale == scale && entry->proportional == proportional )
+  {
+    return entry;
+  }
+
+  const uint8_t *columns = font->columns + ( code - font->first ) * font->width;
+  int start = 0;
+  int end = font->width - 1;
+
+  if ( proportional )
+  {
+    while ( start <= end && columns[ start ] == 0 )
+    {
+      start++;
+    }
+
+    while ( end >= start && columns[ end ] == 0 )
+    {
+      end--;
+    }
+
+    if ( start > end ) //blank glyph, a space keeps half the width
+    {
+      start = 0;
+      end = ( font->width + 1 ) / 2 - 1;
+    }
+  }
+
+  int stride = ( ( end - start + 1 ) * scale + 7 ) / 8;
+
+  for ( int row = 0; row < font->height; row++ )
+  {
+    uint8_t bits = 0;
+
+    for ( int column = start; column <= end; column++ )
+    {
+      bits |= ( ( columns[ column ] >> row ) & 1 ) << ( 7 - ( column - start ) );
+    }
+
+    uint32_t wide = spread[ scale ][ bits ] << ( 32 - 8 * scale );
+
+    for ( int copy = 0; copy < scale; copy++ )
+    {
+      uint8_t *out = entry->bits + ( row * scale + copy ) * stride;
+
+      for ( int byte = 0; byte < stride; byte++ )
+      {
+        out[ byte ] = wide >> ( 24 - 8 * byte );
+      }
+    }
+  }
+
+  entry->font = font;
+  entry->code = code;
+  entry->scale = scale;
+  entry->proportional = proportional;
+  entry->columns = end - start + 1;
+  entry->bitmap.width = entry->columns * scale;
+  entry->bitmap.height = font->height * scale;
+  entry->bitmap.stride = stride;
+  entry->bitmap.bits = entry->bits;
+  entry->bitmap.mask = NULL;
+
+  return entry;
+}
+
+/*
+ * Choose the font the text functions draw with
+ *
+ * Parameters:
+ *  lcd         : lcd to set
+ *  font        : font, lcd128Font5x7 or one laid out the same way
+ *  scale       : 1 to LCD128_FONT_MAX_SCALE, pixels per font pixel
+ *  proportional: 1 = each glyph as wide as its ink | 0 = fixed width
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128SetFont( LCD128 *lcd, const Lcd128Font *font, int scale, int proportional )
+{
+  lcd->font = font;
+  lcd->fontScale = MAX( 1, MIN( scale, LCD128_FONT_MAX_SCALE ) );
+  lcd->fontProportional = proportional ? 1 : 0;
+}
+
+/*
+ * Draw a character into the graphics buffer with a blit, in the current
+ * draw mode: SET ors the glyph in, CLEAR erases it, XOR flips it
+ *
+ * Parameters:
+ *  lcd      : holds the frame buffer and font
+ *  x        : left
+ *  y        : top
+ *  character: char, skipped but advanced over when not in the font
+ *
+ * Return:
+ *  pixels to advance to the next character
+ **************************************************************
+ */
+
+int lcd128DrawChar( LCD128 *lcd, int x, int y, unsigned char character )
+{
+  const Lcd128Font *font = lcd->font ? lcd->font : &lcd128Font5x7;
+  int scale = lcd->font ? lcd->fontScale : 1;
+  int op = ( lcd->drawMode == LCD128_DRAW_CLEAR ) ? LCD128_BLIT_ANDNOT : ( lcd->drawMode == LCD128_DRAW_XOR ) ? LCD128_BLIT_XOR : LCD128_BLIT_OR;
+
+  if ( character < font->first || character >= font->first + font->count )
+  {
+    return ( font->width + font->spacing ) * scale;
+  }
+
+  lcd128FontSpreadInit();
+
+  const Lcd128GlyphEntry *glyph = lcd128FontGlyph( font, character, scale, lcd->fontProportional );
+
+  lcd128Blit( lcd, &glyph->bitmap, x, y, op, 0 );
+
+  return ( glyph->columns + font->spacing ) * scale;
+}
+
+/*
+ * Draw a string into the graphics buffer, '\n' starting a new line
+ * under the first
+ *
+ * Parameters:
+ *  lcd   : holds the frame buffer and font
+ *  x     : left
+ *  y     : top
+ *  string: string
+ *
+ * Return:
+ *  x after the last character drawn
+ **************************************************************
+ */
+
+int lcd128DrawText( LCD128 *lcd, int x, int y, const char *string )
+{
+  const Lcd128Font *font = lcd->font ? lcd->font : &lcd128Font5x7;
+  int scale = lcd->font ? lcd->fontScale : 1;
+  int left = x;
+
+  while ( *string )
+  {
+    if ( *string == '\n' )
+    {
+      x = left;
+      y += ( font->height + 1 ) * scale;
+      string++;
+      continue;
+    }
+
+    x += lcd128DrawChar( lcd, x, y, *string++ );
+  }
+
+  return x;
+}
+
+/*
+ * Draw a formated string into the graphics buffer
+ *
+ * Parameters:
+ *  lcd   : holds the frame buffer and font
+ *  x     : left
+ *  y     : top
+ *  string: formated string
+ *
+ * Return:
+ *  x after the last character drawn
+ **************************************************************
+ */
+
+int lcd128DrawTextf( LCD128 *lcd, int x, int y, const char *string, ... )
+{
+  char buffer[ 1024 ];
+  va_list args;
+
+  va_start( args, string );
+  vsnprintf( buffer, sizeof( buffer ), string, args );
+  va_end( args );
+
+  return lcd128DrawText( lcd, x, y, buffer );
+}
+
+/*
+ * Measure the widest line of a string in the current font
+ *
+ * Parameters:
+ *  lcd   : holds the font
+ *  string: string
+ *
+ * Return:
+ *  width in pixels, including the spacing after the last character
+ **************************************************************
+ */
+
+int lcd128TextWidth( LCD128 *lcd, const char *string )
+{
+  const Lcd128Font *font = lcd->font ? lcd->font : &lcd128Font5x7;
+  int scale = lcd->font ? lcd->fontScale : 1;
+  int width = 0;
+  int widest = 0;
+
+  lcd128FontSpreadInit();
+
+  for ( ; *string; string++ )
+  {
+    unsigned char character = *string;
+
+    if ( character == '\n' )
+    {
+      widest = MAX( widest, width );
+      width = 0;
+    }
+
+    else if ( character < font->first || character >= font->first + font->count )
+    {
+      width += ( font->width + font->spacing ) * scale;
+    }
+
+    else
+    {
+      width += ( lcd128FontGlyph( font, character, scale, lcd->fontProportional )->columns + font->spacing ) * scale;
+    }
+  }
+
+  return MAX( widest, width );
+}
+
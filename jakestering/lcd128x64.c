@@ -30,9 +30,12 @@
 
 #include "jakestering.h"
 #include "lcd128x64.h"
+#include "lcdBus.h"
 
 static const int rowsOffset[4] = { 0x80, 0x90, 0x88, 0x98 };
 
+static const BusTiming safeTiming = { LCD128_ENABLE_NANOS, LCD128_HOLD_NANOS, LCD128_GAP_NANOS };
+
 /*
  * Pulse the enable line 
  *
@@ -47,9 +50,9 @@ static const int rowsOffset[4] = { 0x80, 0x90, 0x88, 0x98 };
 void pulseEnable128( LCD128 *lcd )
 {
   digitalWrite( lcd->E, HIGH );
-  delayMicro( 1 );
+  delayNano( lcd->timing.enableNanos );
   digitalWrite( lcd->E, LOW );
-  delayMicro( 5 );
+  delayNano( lcd->timing.holdNanos );
 }
 
 /*
@@ -66,7 +69,13 @@ void pulseEnable128( LCD128 *lcd )
 
 void sendData128( LCD128 *lcd, const int data )
 {
-  delayMicro( 72 );
+  if ( lcd->bus )
+  {
+    lcdBusQueue( lcd->bus, lcd->busSlot, HIGH, data, lcd->timing.gapNanos );
+    return;
+  }
+
+  delayNano( lcd->timing.gapNanos );
   digitalWriteByte( data, lcd->DB0, lcd->DB7 );
   pulseEnable128( lcd );
 }
@@ -85,11 +94,218 @@ void sendData128( LCD128 *lcd, const int data )
 
 void sendInstruction128( LCD128 *lcd, const int instruction )
 {
+  if ( lcd->bus )
+  {
+    int execNanos = ( instruction == LCD128_DISPLAY_CLEAR ) ? LCD128_EXEC_CLEAR_NANOS : lcd->timing.gapNanos;
+    lcdBusQueue( lcd->bus, lcd->busSlot, LOW, instruction, execNanos );
+    return;
+  }
+
   digitalWrite( lcd->RS, LOW  );
   sendData128( lcd, instruction );
   digitalWrite( lcd->RS, HIGH );
 }
 
+/*
+ * Select the basic or extended instruction set, skipped when the
+ * controller is already in it. G is kept as last set.
+ *
+ * Parameters:
+ *  lcd     : lcd to switch
+ *  extended: 1 = extended | 0 = basic
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128InstructionSet( LCD128 *lcd, int extended )
+{
+  if ( lcd->extended == extended )
+  {
+    return;
+  }
+
+  if ( extended )
+  {
+    lcd->graphics = ( lcd->graphics == 1 );
+    sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION | LCD128_RE_FUNCTION | ( lcd->graphics ? LCD128_G_FUNCTION : 0 ) );
+  }
+
+  else
+  {
+    sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION ); //G is left alone by the basic set
+  }
+
+  lcd->extended = extended;
+}
+
+/*
+ * Set the direction of the data lines
+ *
+ * Parameters:
+ *  lcd : lcd owning the bus
+ *  mode: INPUT/OUTPUT
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128BusMode( LCD128 *lcd, const int mode )
+{
+  pinMode( lcd->DB0, mode );
+  pinMode( lcd->DB1, mode );
+  pinMode( lcd->DB2, mode );
+  pinMode( lcd->DB3, mode );
+  pinMode( lcd->DB4, mode );
+  pinMode( lcd->DB5, mode );
+  pinMode( lcd->DB6, mode );
+  pinMode( lcd->DB7, mode );
+}
+
+/*
+ * Read a data byte back from the lcd, RW must be wired. The first read
+ * after an address set is a dummy that returns stale data.
+ *
+ * Parameters:
+ *  lcd: lcd to read
+ *
+ * Return:
+ *  the byte read
+ **************************************************************
+ */
+
+static int lcd128ReadData( LCD128 *lcd )
+{
+  const int pins[ 8 ] = { lcd->DB0, lcd->DB1, lcd->DB2, lcd->DB3, lcd->DB4, lcd->DB5, lcd->DB6, lcd->DB7 };
+  int data = 0;
+
+  delayNano( lcd->timing.gapNanos );
+  lcd128BusMode( lcd, INPUT );
+  digitalWrite( lcd->RW, HIGH );
+
+  digitalWrite( lcd->E, HIGH );
+  delayNano( lcd->timing.enableNanos );
+
+  for ( int i = 0; i < 8; i++ )
+  {
+    data |= digitalRead( pins[ i ] ) << i;
+  }
+
+  digitalWrite( lcd->E, LOW );
+  delayNano( lcd->timing.holdNanos );
+
+  digitalWrite( lcd->RW, LOW );
+  lcd128BusMode( lcd, OUTPUT );
+
+  return data;
+}
+
+/*
+ * Write a pattern over the first GDRAM row and read it back. Address
+ * sets use safe timing so a failed candidate can't corrupt the mode.
+ *
+ * Parameters:
+ *  device: the LCD128, with the candidate timing set
+ *
+ * Return:
+ *  1 if every byte read back, otherwise 0
+ **************************************************************
+ */
+
+static int lcd128CalibrationTest( void *device )
+{
+  static unsigned int seed = 0;
+  LCD128 *lcd = ( LCD128* )device;
+  BusTiming candidate = lcd->timing;
+  unsigned char pattern[ LCD128_WIDTH / 8 ];
+  int passed = 1;
+
+  seed++; //a new pattern each run, so stale data from the last one can't pass
+
+  for ( int i = 0; i < LCD128_WIDTH / 8; i++ )
+  {
+    pattern[ i ] = ( ( i * 73 + seed * 151 ) ^ ( ( i & 1 ) ? 0x55 : 0xAA ) ) & 0xFF;
+  }
+
+  lcd->timing = safeTiming;
+  sendInstruction128( lcd, 0x80 );
+  sendInstruction128( lcd, 0x80 );
+  lcd->timing = candidate;
+
+  for ( int i = 0; i < LCD128_WIDTH / 8; i++ )
+  {
+    sendData128( lcd, pattern[ i ] );
+  }
+
+  lcd->timing = safeTiming;
+  sendInstruction128( lcd, 0x80 );
+  sendInstruction128( lcd, 0x80 );
+  lcd128ReadData( lcd );
+  lcd->timing = candidate;
+
+  for ( int i = 0; i < LCD128_WIDTH / 8; i++ )
+  {
+    if ( lcd128ReadData( lcd ) != pattern[ i ] )
+    {
+      passed = 0;
+    }
+  }
+
+  return passed;
+}
+
+/*
+ * Find the fastest bus timing this panel handles by writing and reading
+ * back GDRAM, keeping it in lcd->timing. Save it with
+ * jakesteringSaveTiming and load it on later runs to skip this. Leaves
+ * the lcd in graphics mode with the row shown at GDRAM line 0 redrawn
+ * from current.
+ *
+ * Parameters:
+ *  lcd   : lcd with RW wired, not on an LcdBus, whose queued writes the
+ *          readback can't see
+ *  margin: percent added to each minimum found
+ *
+ * Return:
+ *  0 on success, -1 on failure with safe timing kept
+ **************************************************************
+ */
+
+int lcd128Calibrate( LCD128 *lcd, int margin )
+{
+  int result;
+  int row;
+
+  if ( lcd->RW < 0 || lcd->bus )
+  {
+    printf( "Failed: lcd128 calibration needs RW wired, off a shared lcd bus\n" );
+    return -1;
+  }
+
+  lcd->timing = safeTiming;
+  setGraphicsMode( lcd );
+
+  result = jakesteringCalibrate( &lcd->timing, &safeTiming, lcd128CalibrationTest, lcd, margin );
+
+  row = ( LCD128_HEIGHT - lcd->scroll ) & 63; //row the test overwrote, hidden when 32 or more
+
+  if ( row < 32 )
+  {
+    sendInstruction128( lcd, 0x80 );
+    sendInstruction128( lcd, 0x80 );
+
+    for ( int x = 0; x < LCD128_WORDS; x++ )
+    {
+      sendData128( lcd, lcd->current.words[ row ][ x ] >> 8 );
+      sendData128( lcd, lcd->current.words[ row ][ x ] & 0xFF );
+    }
+  }
+
+  return result;
+}
+
 /*
  * Set lcd to Text mode
  *
@@ -103,11 +319,13 @@ void sendInstruction128( LCD128 *lcd, const int instruction )
 
 void setTextMode( LCD128 *lcd )
 {
-  sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION );
+  lcd128InstructionSet( lcd, 0 );
   sendInstruction128( lcd, LCD128_DISPLAY_CLEAR );
   sendInstruction128( lcd, LCD128_RETURN_HOME );
   lcd->cx = 0;
   lcd->cy = 0;
+  memset( lcd->overlay, ' ', sizeof( lcd->overlay ) );
+  memset( lcd->overlayShown, ' ', sizeof( lcd->overlayShown ) );
   delay( 5 );
 }
 
@@ -124,12 +342,14 @@ void setTextMode( LCD128 *lcd )
 
 void lcd128ClearText( LCD128 *lcd )
 {
-  sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION );
+  lcd128InstructionSet( lcd, 0 );
   sendInstruction128( lcd, 0x01 );
   delay( 2 );
   sendInstruction128( lcd, 0x02 );
   lcd->cx = 0;
   lcd->cy = 0;
+  memset( lcd->overlay, ' ', sizeof( lcd->overlay ) );
+  memset( lcd->overlayShown, ' ', sizeof( lcd->overlayShown ) );
   delay( 5 );
 }
 
@@ -147,16 +367,17 @@ void lcd128ClearText( LCD128 *lcd )
 
 void lcd128CursorPosition( LCD128 *lcd, int x, int y )
 {
-  if ( ( x > lcd->cols ) || ( x < 0 ) )
+  if ( ( x >= lcd->cols ) || ( x < 0 ) )
   {
     return;
   }
 
-  if ( ( y > lcd->rows ) || ( y < 0 ) )
+  if ( ( y >= lcd->rows ) || ( y < 0 ) ) //rowsOffset has one entry per row
   {
     return;
   }
 
+  lcd128InstructionSet( lcd, 0 );
   sendInstruction128( lcd, x + ( LCD128_DDRAM_SET | rowsOffset[ y ] ) );
 
   lcd->cx = x;
@@ -179,6 +400,7 @@ void lcd128PutChar( LCD128 *lcd, unsigned char character, int byte )
 {
   if( byte ) sendData128( lcd, 0x20 );
   sendData128( lcd, character );
+  memset( lcd->overlayShown, 0, sizeof( lcd->overlayShown ) ); //DDRAM written behind the overlay's back
   
   if ( ++lcd->cx == lcd->cols )
   {
@@ -238,402 +460,1816 @@ void lcd128Printf( LCD128 *lcd, int byte, const char *string, ... )
 }
 
 /*
- * Set lcd to graphics mode
+ * Blank the text overlay, sent by the next lcd128Present
  *
  * Parameters:
- *  lcd: to set graphics mode
+ *  lcd: lcd holding the overlay
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void setGraphicsMode( LCD128 *lcd )
+void lcd128OverlayClear( LCD128 *lcd )
 {
-  sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION | LCD128_RE_FUNCTION );
-  sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION | LCD128_RE_FUNCTION | LCD128_G_FUNCTION );
-  delay( 5 );
+  memset( lcd->overlay, ' ', sizeof( lcd->overlay ) );
 }
 
 /*
- * Clear the graphics buffer
+ * Write a string into the text overlay, cut at the end of the line. It
+ * is shown over the graphics by the next lcd128Present.
  *
  * Parameters:
- *  lcd: pointer to screen buffer
+ *  lcd   : lcd holding the overlay
+ *  x     : column, 0 to LCD128_TEXT_COLS - 1
+ *  y     : line, 0 to LCD128_TEXT_ROWS - 1
+ *  string: string
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128ClearGraphics( LCD128 *lcd )
+void lcd128OverlayPuts( LCD128 *lcd, int x, int y, const char *string )
 {
-  for ( uint8_t y = 0; y < 64; y++ )
+  if ( y < 0 || y >= LCD128_TEXT_ROWS )
   {
-    if ( y < 32 )
-    {
-      sendInstruction128( lcd, 0x80 | y );
-      sendInstruction128( lcd, 0x80 );
-    }
-
-    else
-    {
-      sendInstruction128( lcd, 0x80 | y - 32 );
-      sendInstruction128( lcd, 0x88 );
-    }
+    return;
+  }
 
-    for ( uint8_t x = 0; x < 8; x++ )
+  for ( ; *string && x < LCD128_TEXT_COLS; x++, string++ )
+  {
+    if ( x >= 0 )
     {
-      sendData128( lcd, 0x00 );
-      sendData128( lcd, 0x00 );
+      lcd->overlay[ y ][ x ] = *string;
     }
   }
 }
 
 /*
- * Set the pixel at x, y
+ * Write a formated string into the text overlay
  *
  * Parameters:
- *  lcd: holds the pixel info
- *  x  : horizontal position
- *  y  : vertical position
+ *  lcd   : lcd holding the overlay
+ *  x     : column
+ *  y     : line
+ *  string: formated string
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawPixel( LCD128 *lcd, int x, int y )
+void lcd128OverlayPrintf( LCD128 *lcd, int x, int y, const char *string, ... )
 {
-  if ( ( x < LCD128_WIDTH && x >= 0 ) || ( y < LCD128_HEIGHT && y >= 0 ) )
-  {
-    lcd->buffer[ y ][ x / 16 ] |= ( 1 << ( 15 - ( x % 16 ) ) );
-  }
+  char buffer[ LCD128_TEXT_COLS + 1 ];
+  va_list args;
+
+  va_start( args, string );
+  vsnprintf( buffer, sizeof( buffer ), string, args );
+  va_end( args );
+
+  lcd128OverlayPuts( lcd, x, y, buffer );
 }
 
 /*
- * Clear the pixel at x, y
+ * Send the frame: changed GDRAM words through lcd128UpdateScreen, then
+ * changed overlay text, a DDRAM address per run of changed character
+ * pairs. Each half switches instruction set only when it has work, so
+ * a frame with no text changes sends no basic instructions at all.
  *
  * Parameters:
- *  lcd: holds the pixel info
- *  x  : horizontal position
- *  y  : vertical position
+ *  lcd: lcd in graphics mode
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128ClearPixel( LCD128 *lcd, int x, int y )
+void lcd128Present( LCD128 *lcd )
 {
-  if ( ( x < LCD128_WIDTH && x > 0 ) || ( y < LCD128_HEIGHT && y > 0 ) )
+  lcd128UpdateScreen( lcd );
+
+  for ( int y = 0; y < LCD128_TEXT_ROWS; y++ )
   {
-    lcd->buffer[ y ][ x / 16 ] &= ~( 0x01 << ( 15 - ( y % 16 ) ) );
+    int pair = 0;
+
+    while ( pair < LCD128_TEXT_COLS / 2 )
+    {
+      if ( memcmp( &lcd->overlay[ y ][ pair * 2 ], &lcd->overlayShown[ y ][ pair * 2 ], 2 ) == 0 )
+      {
+        pair++;
+        continue;
+      }
+
+      lcd128InstructionSet( lcd, 0 );
+      sendInstruction128( lcd, LCD128_DDRAM_SET | ( rowsOffset[ y ] + pair ) );
+
+      for ( ; pair < LCD128_TEXT_COLS / 2 && memcmp( &lcd->overlay[ y ][ pair * 2 ], &lcd->overlayShown[ y ][ pair * 2 ], 2 ) != 0; pair++ )
+      {
+        sendData128( lcd, lcd->overlay[ y ][ pair * 2 ] );
+        sendData128( lcd, lcd->overlay[ y ][ pair * 2 + 1 ] );
+        lcd->overlayShown[ y ][ pair * 2 ] = lcd->overlay[ y ][ pair * 2 ];
+        lcd->overlayShown[ y ][ pair * 2 + 1 ] = lcd->overlay[ y ][ pair * 2 + 1 ];
+      }
+    }
   }
 }
 
 /*
- * Draw a line between two points
+ * Set lcd to graphics mode. Only the instructions the controller's
+ * current state needs are sent; DDRAM text stays shown over the
+ * graphics.
  *
  * Parameters:
- *  x1: first x position
- *  y1: first y position
- *  x2: second x position
- *  y2: second y position
- *  
+ *  lcd: to set graphics mode
+ *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawLine( LCD128 *lcd, int x1, int y1, int x2, int y2 )
+void setGraphicsMode( LCD128 *lcd )
 {
-  int deltaX =  abs( x2 - x1 ), screenX = x1 < x2 ? 1 : -1;
-  int deltaY = -abs( y2 - y1 ), screenY = y1 < y2 ? 1 : -1;
-  int error = deltaX + deltaY;
-  int error2;
+  lcd128InstructionSet( lcd, 1 );
 
-  while ( 1 )
+  if ( lcd->graphics != 1 )
   {
-    lcd128DrawPixel( lcd, x1, y1 );
-    
-    if ( x1 == x2 && y1 == y2 ) break;
-    
-    error2 = 2 * error;
-    
-    if ( error2 >= deltaY )
-    { 
-      error += deltaY;
-      x1 += screenX;
-    }
-
-    if ( error2 <= deltaX )
-    {
-      error += deltaX;
-      y1 += screenY;
-    }
+    sendInstruction128( lcd, LCD128_FUNCTION_SET | LCD128_DL_FUNCTION | LCD128_RE_FUNCTION | LCD128_G_FUNCTION ); //RE has to be set before G changes
+    lcd->graphics = 1;
   }
 }
 
 /*
- * Draws a rect to the screen at the given point with the given width and height
+ * Compare one row of two frames
  *
  * Parameters:
- *  lcd   : Holds screen frame buffer
- *  x     : Horizontal position
- *  y     : Vertical position
- *  width : 
- *  height:
+ *  a: first frame
+ *  b: second frame
+ *  y: row
  *
- * Remove:
- *  void
+ * Return:
+ *  1 if the rows match, otherwise 0
  **************************************************************
  */
 
-void lcd128DrawRect(LCD128 *lcd, int x, int y, int width, int height )
+static int lcd128RowSame( const Lcd128Frame *a, const Lcd128Frame *b, int y )
 {
-  lcd128DrawLine( lcd, x, y, x + width, y );
-  lcd128DrawLine( lcd, x + width, y, x + width, y + height );
-  lcd128DrawLine( lcd, x + width, y + height, x, y + height );
-  lcd128DrawLine( lcd, x, y + height, x, y );
+  return ( ( a->longs[ y ][ 0 ] ^ b->longs[ y ][ 0 ] ) | ( a->longs[ y ][ 1 ] ^ b->longs[ y ][ 1 ] ) ) == 0;
 }
 
 /*
- * Draws a filled rect to the screen at the given point with the given width and height
+ * Check a row of a frame for lit pixels
  *
  * Parameters:
- *  lcd   : Holds screen frame buffer
- *  x     : Horizontal position
- *  y     : Vertical position
- *  width : 
- *  height:
+ *  frame: frame to check
+ *  y    : row
  *
- * Remove:
- *  void
+ * Return:
+ *  1 if every pixel in the row is off, otherwise 0
  **************************************************************
  */
 
-void lcd128DrawFilledRect(LCD128 *lcd, int x, int y, int width, int height )
+static int lcd128RowBlank( const Lcd128Frame *frame, int y )
 {
-  for ( int i = x; i <= x + width; i++ )
-  {
-    lcd128DrawLine( lcd, i, y, i, y + height );
-  }
+  return ( frame->longs[ y ][ 0 ] | frame->longs[ y ][ 1 ] ) == 0;
 }
 
 /*
- * Internal circle draw routine
+ * Point the GDRAM address counter at a word. Rows 32-63 are the right
+ * half of rows 0-31 in GDRAM, and both halves are shown from the line
+ * the vertical scroll offset points at.
  *
  * Parameters:
- *  xc: center x position
- *  yc: center y position
- *  x : offset
- *  y : offset
+ *  lcd: lcd in graphics mode
+ *  x  : word in the row, 0 to LCD128_WORDS - 1
+ *  y  : row, 0 to LCD128_HEIGHT - 1
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void circleInternal( LCD128 *lcd, int xc, int yc, int x, int y )
+static void lcd128GdramAddress( LCD128 *lcd, int x, int y )
 {
-  lcd128DrawPixel( lcd, xc + x, yc + y );
-  lcd128DrawPixel( lcd, xc + x, yc - y );
-  lcd128DrawPixel( lcd, xc - x, yc + y );
-  lcd128DrawPixel( lcd, xc - x, yc - y );
-  lcd128DrawPixel( lcd, xc + y, yc + x );
-  lcd128DrawPixel( lcd, xc + y, yc - x );
-  lcd128DrawPixel( lcd, xc - y, yc + x );
-  lcd128DrawPixel( lcd, xc - y, yc - x );
+  lcd128InstructionSet( lcd, 1 );
+
+  sendInstruction128( lcd, 0x80 | ( ( ( y & 31 ) + lcd->scroll ) & 63 ) );
+  sendInstruction128( lcd, ( y < 32 ? 0x80 : 0x88 ) | x );
 }
 
 /*
- * Draw a circle at given x, y with given radius using bresenham's circle algorithm
+ * Note that the word holding x, y changed, so the next update sends it
  *
  * Parameters:
- *  xc: center x position
- *  xy: center y position
- *  r : radius
+ *  lcd: lcd whose buffer changed
+ *  x  : horizontal position
+ *  y  : vertical position
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawCircle( LCD128 *lcd, int xc, int yc, int r )
+static void lcd128MarkDirty( LCD128 *lcd, int x, int y )
 {
-  int x = 0;
-  int y = r;
-  int decision = 5 - ( 4 * r );
-
-  while ( x <= y )
-  {
-    circleInternal( lcd, xc, yc, x, y );
-    if ( decision > 0 )
-    {
-      y--;
-      decision -= 8 *  y;
-    }
-
-    x++;
-    
-    decision += 8 * x + 4;
-  }
+  lcd->dirty[ y ] |= 1 << ( x / 16 );
+  lcd->dirtyRows |= 1ULL << y;
 }
 
 /*
- * Draw a circle at given x, y with given radius using bresenham's circle algorithm
+ * Apply a draw mode to the pixels of a word picked by mask
  *
  * Parameters:
- *  xc: center x position
- *  xy: center y position
- *  r : radius
+ *  word: buffer word
+ *  mask: pixels to change
+ *  mode: LCD128_DRAW_SET | LCD128_DRAW_CLEAR | LCD128_DRAW_XOR
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawFilledCircle( LCD128 *lcd, int xc, int yc, int r )
+static void lcd128ApplyMask( uint16_t *word, uint16_t mask, int mode )
 {
-  int x = 0;
-  int y = r;
-  int decision = 5 - ( 4 * r );
-
-  while ( x <= y )
+  switch ( mode )
   {
-    lcd128DrawLine( lcd, xc - x, yc - y, xc + x, yc - y );
-    lcd128DrawLine( lcd, xc - y, yc - x, xc + y, yc - x );
-    lcd128DrawLine( lcd, xc - y, yc + x, xc + y, yc + x );
-    lcd128DrawLine( lcd, xc - x, yc + y, xc + x, yc + y );
+    case LCD128_DRAW_CLEAR:
+      *word &= ~mask;
+      break;
 
-    if ( decision > 0 )
+    case LCD128_DRAW_XOR:
+      *word ^= mask;
+      break;
+
+    default:
+      *word |= mask;
+      break;
+  }
+}
+
+/*
+ * Fill x0 to x1 on a row, a head and tail mask for the partial words
+ * and whole words between. Clipped to the clip rect once up front.
+ *
+ * Parameters:
+ *  lcd : holds the frame buffer
+ *  x0  : left, inclusive
+ *  x1  : right, inclusive
+ *  y   : row
+ *  mode: LCD128_DRAW_SET | LCD128_DRAW_CLEAR | LCD128_DRAW_XOR
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128Span( LCD128 *lcd, int x0, int x1, int y, int mode )
+{
+  if ( y < lcd->clip.top || y > lcd->clip.bottom )
+  {
+    return;
+  }
+
+  x0 = MAX( x0, lcd->clip.left );
+  x1 = MIN( x1, lcd->clip.right );
+
+  if ( x0 > x1 )
+  {
+    return;
+  }
+
+  uint16_t *row = lcd->buffer.words[ y ];
+  int first = x0 / 16;
+  int last = x1 / 16;
+  uint16_t head = 0xFFFF >> ( x0 % 16 );
+  uint16_t tail = 0xFFFF << ( 15 - ( x1 % 16 ) );
+
+  if ( first == last )
+  {
+    lcd128ApplyMask( &row[ first ], head & tail, mode );
+  }
+
+  else
+  {
+    lcd128ApplyMask( &row[ first ], head, mode );
+
+    for ( int word = first + 1; word < last; word++ )
+    {
+      lcd128ApplyMask( &row[ word ], 0xFFFF, mode );
+    }
+
+    lcd128ApplyMask( &row[ last ], tail, mode );
+  }
+
+  lcd->dirty[ y ] |= ( ( 2 << last ) - 1 ) & ~( ( 1 << first ) - 1 );
+  lcd->dirtyRows |= 1ULL << y;
+}
+
+/*
+ * Draw y0 to y1 down one column, clipped to the clip rect once up front
+ *
+ * Parameters:
+ *  lcd : holds the frame buffer
+ *  x   : column
+ *  y0  : top, inclusive
+ *  y1  : bottom, inclusive
+ *  mode: LCD128_DRAW_SET | LCD128_DRAW_CLEAR | LCD128_DRAW_XOR
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128Column( LCD128 *lcd, int x, int y0, int y1, int mode )
+{
+  if ( x < lcd->clip.left || x > lcd->clip.right )
+  {
+    return;
+  }
+
+  uint16_t bit = 1 << ( 15 - ( x % 16 ) );
+
+  for ( int y = MAX( y0, lcd->clip.top ); y <= MIN( y1, lcd->clip.bottom ); y++ )
+  {
+    lcd128ApplyMask( &lcd->buffer.words[ y ][ x / 16 ], bit, mode );
+    lcd128MarkDirty( lcd, x, y );
+  }
+}
+
+/*
+ * Draw a pixel already known to be inside the clip rect
+ *
+ * Parameters:
+ *  lcd : holds the frame buffer
+ *  x   : horizontal position
+ *  y   : vertical position
+ *  mode: LCD128_DRAW_SET | LCD128_DRAW_CLEAR | LCD128_DRAW_XOR
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128Plot( LCD128 *lcd, int x, int y, int mode )
+{
+  lcd128ApplyMask( &lcd->buffer.words[ y ][ x / 16 ], 1 << ( 15 - ( x % 16 ) ), mode );
+  lcd128MarkDirty( lcd, x, y );
+}
+
+/*
+ * Divide rounding up, for a positive divisor
+ *
+ * Parameters:
+ *  a: dividend
+ *  b: divisor, greater than 0
+ *
+ * Return:
+ *  a / b rounded towards positive infinity
+ **************************************************************
+ */
+
+static int64_t lcd128CeilDiv( int64_t a, int64_t b )
+{
+  return ( a >= 0 ) ? ( a + b - 1 ) / b : -( -a / b );
+}
+
+/*
+ * Cohen-Sutherland region code of a point against the clip rect
+ *
+ * Parameters:
+ *  clip: clip rect
+ *  x   : horizontal position
+ *  y   : vertical position
+ *
+ * Return:
+ *  bits 1 = left, 2 = right, 4 = above, 8 = below, 0 when inside
+ **************************************************************
+ */
+
+static int lcd128OutCode( const Lcd128Clip *clip, int64_t x, int64_t y )
+{
+  return ( ( x < clip->left ) ? 1 : ( x > clip->right ) ? 2 : 0 ) | ( ( y < clip->top ) ? 4 : ( y > clip->bottom ) ? 8 : 0 );
+}
+
+/*
+ * Scale a by b / c, rounding to the nearest integer. The product of two
+ * int differences can pass int64, so it is taken in long double; only the
+ * guard clip uses this, where the ends it finds are far off screen.
+ *
+ * Parameters:
+ *  a: value to scale
+ *  b: numerator
+ *  c: denominator, not 0
+ *
+ * Return:
+ *  a * b / c rounded, halves away from zero
+ **************************************************************
+ */
+
+static int64_t lcd128ScaleRound( int64_t a, int64_t b, int64_t c )
+{
+  return llroundl( ( long double )a * b / c );
+}
+
+/*
+ * Clip a line with Cohen-Sutherland, moving each end outside onto the
+ * edge it crosses. Rounding the new ends shifts the line slightly, so
+ * this is only used to pull in lines beyond LCD128_GUARD.
+ *
+ * Parameters:
+ *  clip: clip rect
+ *  x1  : first x position, updated
+ *  y1  : first y position, updated
+ *  x2  : second x position, updated
+ *  y2  : second y position, updated
+ *
+ * Return:
+ *  1 if part of the line is inside, 0 if none is
+ **************************************************************
+ */
+
+static int lcd128ClipLine( const Lcd128Clip *clip, int *x1, int *y1, int *x2, int *y2 )
+{
+  int64_t ax = *x1, ay = *y1, bx = *x2, by = *y2;
+  int codeA = lcd128OutCode( clip, ax, ay );
+  int codeB = lcd128OutCode( clip, bx, by );
+
+  for ( int pass = 0; pass < 8; pass++ ) //each pass settles one edge for one end, rounding can't add more
+  {
+    if ( ( codeA | codeB ) == 0 )
+    {
+      *x1 = ax;
+      *y1 = ay;
+      *x2 = bx;
+      *y2 = by;
+      return 1;
+    }
+
+    if ( codeA & codeB )
+    {
+      return 0;
+    }
+
+    int code = codeA ? codeA : codeB;
+    int64_t x, y;
+
+    if ( code & 4 )
+    {
+      y = clip->top;
+      x = ax + lcd128ScaleRound( bx - ax, y - ay, by - ay );
+    }
+
+    else if ( code & 8 )
+    {
+      y = clip->bottom;
+      x = ax + lcd128ScaleRound( bx - ax, y - ay, by - ay );
+    }
+
+    else if ( code & 1 )
+    {
+      x = clip->left;
+      y = ay + lcd128ScaleRound( by - ay, x - ax, bx - ax );
+    }
+
+    else
+    {
+      x = clip->right;
+      y = ay + lcd128ScaleRound( by - ay, x - ax, bx - ax );
+    }
+
+    if ( code == codeA )
+    {
+      ax = x;
+      ay = y;
+      codeA = lcd128OutCode( clip, ax, ay );
+    }
+
+    else
+    {
+      bx = x;
+      by = y;
+      codeB = lcd128OutCode( clip, bx, by );
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Draw the part of a line inside the clip rect with exactly the pixels
+ * the whole line would get. Step i along the major axis lands at
+ * floor( ( 2 * i * minor + major ) / ( 2 * major ) ) on the minor axis,
+ * so the steps inside the clip are solved for and only those walked.
+ *
+ * Parameters:
+ *  lcd : holds the frame buffer
+ *  x1  : first x position
+ *  y1  : first y position
+ *  x2  : second x position
+ *  y2  : second y position, the line neither horizontal nor vertical
+ *  open: 1 = leave out x2, y2 | 0 = draw it
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128ClippedLine( LCD128 *lcd, int x1, int y1, int x2, int y2, int open )
+{
+  int xMajor = abs( x2 - x1 ) >= abs( y2 - y1 );
+  int64_t major = xMajor ? abs( x2 - x1 ) : abs( y2 - y1 );
+  int64_t minor = xMajor ? abs( y2 - y1 ) : abs( x2 - x1 );
+  int stepA = ( xMajor ? x2 > x1 : y2 > y1 ) ? 1 : -1;
+  int stepB = ( xMajor ? y2 > y1 : x2 > x1 ) ? 1 : -1;
+  int64_t a0 = xMajor ? x1 : y1;
+  int64_t b0 = xMajor ? y1 : x1;
+  int64_t lowA  = xMajor ? lcd->clip.left  : lcd->clip.top;
+  int64_t highA = xMajor ? lcd->clip.right : lcd->clip.bottom;
+  int64_t lowB  = xMajor ? lcd->clip.top    : lcd->clip.left;
+  int64_t highB = xMajor ? lcd->clip.bottom : lcd->clip.right;
+
+  int64_t first = ( stepA > 0 ) ? lowA - a0 : a0 - highA;
+  int64_t last  = ( stepA > 0 ) ? highA - a0 : a0 - lowA;
+  int64_t fromB = ( stepB > 0 ) ? lowB - b0 : b0 - highB; //minor offsets inside the clip
+  int64_t toB   = ( stepB > 0 ) ? highB - b0 : b0 - lowB;
+
+  if ( toB < 0 )
+  {
+    return;
+  }
+
+  if ( fromB > 0 )
+  {
+    first = MAX( first, lcd128CeilDiv( ( 2 * fromB - 1 ) * major, 2 * minor ) );
+  }
+
+  last = MIN( last, lcd128CeilDiv( ( 2 * toB + 1 ) * major, 2 * minor ) - 1 );
+  first = MAX( first, 0 );
+  last = MIN( last, major - open );
+
+  if ( first > last )
+  {
+    return;
+  }
+
+  int64_t remainder = 2 * first * minor + major;
+  int a = a0 + stepA * first;
+  int b = b0 + stepB * ( remainder / ( 2 * major ) );
+
+  remainder %= 2 * major;
+
+  for ( int64_t i = first; i <= last; i++ )
+  {
+    if ( xMajor )
+    {
+      lcd128Plot( lcd, a, b, lcd->drawMode );
+    }
+
+    else
+    {
+      lcd128Plot( lcd, b, a, lcd->drawMode );
+    }
+
+    a += stepA;
+    remainder += 2 * minor;
+
+    if ( remainder >= 2 * major )
+    {
+      remainder -= 2 * major;
+      b += stepB;
+    }
+  }
+}
+
+/*
+ * Plot the eight symmetric points of a circle step, all known to be
+ * inside the clip rect. Points that coincide on the axes and diagonals
+ * are plotted once, so XOR circles stay closed.
+ *
+ * Parameters:
+ *  xc: center x position
+ *  yc: center y position
+ *  x : offset
+ *  y : offset
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128CircleOctants( LCD128 *lcd, int xc, int yc, int x, int y )
+{
+  lcd128Plot( lcd, xc + x, yc + y, lcd->drawMode );
+
+  if ( y != 0 ) //r = 0 is a single point
+  {
+    lcd128Plot( lcd, xc + x, yc - y, lcd->drawMode );
+  }
+
+  if ( x != 0 ) //on the axes the mirrored points coincide
+  {
+    lcd128Plot( lcd, xc - x, yc + y, lcd->drawMode );
+    lcd128Plot( lcd, xc - x, yc - y, lcd->drawMode );
+  }
+
+  if ( x != y ) //on the diagonals the swapped points coincide
+  {
+    lcd128Plot( lcd, xc + y, yc + x, lcd->drawMode );
+    lcd128Plot( lcd, xc - y, yc + x, lcd->drawMode );
+
+    if ( x != 0 )
+    {
+      lcd128Plot( lcd, xc + y, yc - x, lcd->drawMode );
+      lcd128Plot( lcd, xc - y, yc - x, lcd->drawMode );
+    }
+  }
+}
+
+/*
+ * Clear the graphics buffer
+ *
+ * Parameters:
+ *  lcd: pointer to screen buffer
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128ClearGraphics( LCD128 *lcd )
+{
+  for ( uint8_t y = 0; y < 64; y++ )
+  {
+    lcd128GdramAddress( lcd, 0, y );
+
+    for ( uint8_t x = 0; x < 8; x++ )
+    {
+      sendData128( lcd, 0x00 );
+      sendData128( lcd, 0x00 );
+    }
+  }
+
+  memset( &lcd->current, 0, sizeof( lcd->current ) );
+  memset( lcd->dirty, ( 1 << LCD128_WORDS ) - 1, sizeof( lcd->dirty ) ); //anything left in buffer goes out next update
+  lcd->dirtyRows = ~0ULL;
+  lcd->staleRows = 0;
+}
+
+/*
+ * Keep the buffer across updates, so only what changes has to be drawn
+ * again. Erase with lcd128ClearRect, lcd128ClearPixel or a CLEAR/XOR
+ * draw mode.
+ *
+ * Parameters:
+ *  lcd  : lcd to set
+ *  value: 1 = retained | 0 = buffer cleared after each update
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128Retained( LCD128 *lcd, int value )
+{
+  lcd->retained = value ? 1 : 0;
+}
+
+/*
+ * Choose what drawing does to the pixels it touches
+ *
+ * Parameters:
+ *  lcd : lcd to set
+ *  mode: LCD128_DRAW_SET | LCD128_DRAW_CLEAR | LCD128_DRAW_XOR
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawMode( LCD128 *lcd, int mode )
+{
+  lcd->drawMode = mode;
+}
+
+/*
+ * Narrow drawing to a rect inside the current clip, covering the same
+ * pixels as lcd128DrawFilledRect, until the matching lcd128PopClip
+ *
+ * Parameters:
+ *  lcd   : lcd to clip
+ *  x     : left
+ *  y     : top
+ *  width : right is x + width
+ *  height: bottom is y + height
+ *
+ * Return:
+ *  0 on success, -1 when LCD128_CLIP_DEPTH clips are already pushed
+ **************************************************************
+ */
+
+int lcd128PushClip( LCD128 *lcd, int x, int y, int width, int height )
+{
+  if ( lcd->clipDepth == LCD128_CLIP_DEPTH )
+  {
+    printf( "Failed: lcd128 clip stack is full\n" );
+    return -1;
+  }
+
+  lcd->clipStack[ lcd->clipDepth++ ] = lcd->clip;
+
+  lcd->clip.left   = MAX( lcd->clip.left,   MIN( x, x + width ) );
+  lcd->clip.right  = MIN( lcd->clip.right,  MAX( x, x + width ) );
+  lcd->clip.top    = MAX( lcd->clip.top,    MIN( y, y + height ) );
+  lcd->clip.bottom = MIN( lcd->clip.bottom, MAX( y, y + height ) );
+
+  return 0;
+}
+
+/*
+ * Restore the clip from before the last lcd128PushClip
+ *
+ * Parameters:
+ *  lcd: lcd to clip
+ *
+ * Return:
+ *  0 on success, -1 when nothing was pushed
+ **************************************************************
+ */
+
+int lcd128PopClip( LCD128 *lcd )
+{
+  if ( lcd->clipDepth == 0 )
+  {
+    printf( "Failed: lcd128 clip stack is empty\n" );
+    return -1;
+  }
+
+  lcd->clip = lcd->clipStack[ --lcd->clipDepth ];
+
+  return 0;
+}
+
+/*
+ * Set the pixel at x, y
+ *
+ * Parameters:
+ *  lcd: holds the pixel info
+ *  x  : horizontal position
+ *  y  : vertical position
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawPixel( LCD128 *lcd, int x, int y )
+{
+  if ( x >= lcd->clip.left && x <= lcd->clip.right && y >= lcd->clip.top && y <= lcd->clip.bottom )
+  {
+    lcd128Plot( lcd, x, y, lcd->drawMode );
+  }
+}
+
+/*
+ * Clear the pixel at x, y
+ *
+ * Parameters:
+ *  lcd: holds the pixel info
+ *  x  : horizontal position
+ *  y  : vertical position
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128ClearPixel( LCD128 *lcd, int x, int y )
+{
+  if ( x >= lcd->clip.left && x <= lcd->clip.right && y >= lcd->clip.top && y <= lcd->clip.bottom )
+  {
+    lcd128Plot( lcd, x, y, LCD128_DRAW_CLEAR );
+  }
+}
+
+/*
+ * Draw a horizontal run of pixels in the current draw mode
+ *
+ * Parameters:
+ *  lcd: holds the frame buffer
+ *  x0 : one end, inclusive
+ *  x1 : other end, inclusive
+ *  y  : row
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawSpan( LCD128 *lcd, int x0, int x1, int y )
+{
+  lcd128Span( lcd, MIN( x0, x1 ), MAX( x0, x1 ), y, lcd->drawMode );
+}
+
+/*
+ * Turn off every pixel of a rect, covering the same pixels as
+ * lcd128DrawFilledRect with the same arguments
+ *
+ * Parameters:
+ *  lcd   : holds the frame buffer
+ *  x     : left
+ *  y     : top
+ *  width : right is x + width
+ *  height: bottom is y + height
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128ClearRect( LCD128 *lcd, int x, int y, int width, int height )
+{
+  for ( int row = MIN( y, y + height ); row <= MAX( y, y + height ); row++ )
+  {
+    lcd128Span( lcd, MIN( x, x + width ), MAX( x, x + width ), row, LCD128_DRAW_CLEAR );
+  }
+}
+
+/*
+ * Draw a line between two points. Cohen-Sutherland region codes drop
+ * lines wholly outside the clip rect and send lines crossing it to
+ * lcd128ClippedLine, so only visible pixels are walked.
+ *
+ * Parameters:
+ *  lcd : holds the frame buffer
+ *  x1  : first x position
+ *  y1  : first y position
+ *  x2  : second x position
+ *  y2  : second y position
+ *  open: 1 = leave out x2, y2, so outlines joined end to start draw
+ *        every corner once | 0 = draw it
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128Line( LCD128 *lcd, int x1, int y1, int x2, int y2, int open )
+{
+  if ( y1 == y2 || x1 == x2 )
+  {
+    if ( open )
+    {
+      if ( x1 == x2 && y1 == y2 )
+      {
+        return;
+      }
+
+      x2 -= ( x2 > x1 ) - ( x2 < x1 );
+      y2 -= ( y2 > y1 ) - ( y2 < y1 );
+    }
+
+    if ( y1 == y2 )
+    {
+      lcd128Span( lcd, MIN( x1, x2 ), MAX( x1, x2 ), y1, lcd->drawMode );
+    }
+
+    else
+    {
+      lcd128Column( lcd, x1, MIN( y1, y2 ), MAX( y1, y2 ), lcd->drawMode );
+    }
+
+    return;
+  }
+
+  int codeA = lcd128OutCode( &lcd->clip, x1, y1 );
+  int codeB = lcd128OutCode( &lcd->clip, x2, y2 );
+
+  if ( codeA & codeB )
+  {
+    return;
+  }
+
+  if ( codeA | codeB )
+  {
+    const Lcd128Clip guard = { -LCD128_GUARD, -LCD128_GUARD, LCD128_GUARD, LCD128_GUARD };
+
+    if ( lcd128OutCode( &guard, x1, y1 ) | lcd128OutCode( &guard, x2, y2 ) ) //too far out for exact 64-bit math, cut nearer first
+    {
+      if ( !lcd128ClipLine( &guard, &x1, &y1, &x2, &y2 ) || x1 == x2 || y1 == y2 )
+      {
+        return;
+      }
+    }
+
+    lcd128ClippedLine( lcd, x1, y1, x2, y2, open );
+    return;
+  }
+
+  int deltaX =  abs( x2 - x1 ), screenX = x1 < x2 ? 1 : -1;
+  int deltaY = -abs( y2 - y1 ), screenY = y1 < y2 ? 1 : -1;
+  int error = deltaX + deltaY;
+  int error2;
+
+  while ( 1 )
+  {
+    if ( x1 == x2 && y1 == y2 )
+    {
+      if ( !open )
+      {
+        lcd128Plot( lcd, x1, y1, lcd->drawMode );
+      }
+
+      break;
+    }
+
+    lcd128Plot( lcd, x1, y1, lcd->drawMode ); //both ends inside the clip, so is every point between
+    
+    error2 = 2 * error;
+    
+    if ( error2 >= deltaY )
+    { 
+      error += deltaY;
+      x1 += screenX;
+    }
+
+    if ( error2 <= deltaX )
+    {
+      error += deltaX;
+      y1 += screenY;
+    }
+  }
+}
+
+/*
+ * Draw a line between two points
+ *
+ * Parameters:
+ *  x1: first x position
+ *  y1: first y position
+ *  x2: second x position
+ *  y2: second y position
+ *  
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawLine( LCD128 *lcd, int x1, int y1, int x2, int y2 )
+{
+  lcd128Line( lcd, x1, y1, x2, y2, 0 );
+}
+
+/*
+ * Draws a rect to the screen at the given point with the given width and height
+ *
+ * Parameters:
+ *  lcd   : Holds screen frame buffer
+ *  x     : Horizontal position
+ *  y     : Vertical position
+ *  width : 
+ *  height:
+ *
+ * Remove:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawRect(LCD128 *lcd, int x, int y, int width, int height )
+{
+  int left   = MIN( x, x + width );
+  int right  = MAX( x, x + width );
+  int top    = MIN( y, y + height );
+  int bottom = MAX( y, y + height );
+
+  lcd128Span( lcd, left, right, top, lcd->drawMode ); //each pixel once, so XOR outlines stay closed
+
+  if ( bottom != top )
+  {
+    lcd128Span( lcd, left, right, bottom, lcd->drawMode );
+  }
+
+  lcd128Column( lcd, left, top + 1, bottom - 1, lcd->drawMode );
+
+  if ( right != left )
+  {
+    lcd128Column( lcd, right, top + 1, bottom - 1, lcd->drawMode );
+  }
+}
+
+/*
+ * Draws a filled rect to the screen at the given point with the given width and height
+ *
+ * Parameters:
+ *  lcd   : Holds screen frame buffer
+ *  x     : Horizontal position
+ *  y     : Vertical position
+ *  width : 
+ *  height:
+ *
+ * Remove:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawFilledRect(LCD128 *lcd, int x, int y, int width, int height )
+{
+  for ( int row = MIN( y, y + height ); row <= MAX( y, y + height ); row++ )
+  {
+    lcd128Span( lcd, MIN( x, x + width ), MAX( x, x + width ), row, lcd->drawMode );
+  }
+}
+
+/*
+ * Internal circle draw routine, clipping each point. Coinciding points
+ * are drawn once, as in lcd128CircleOctants.
+ *
+ * Parameters:
+ *  xc: center x position
+ *  yc: center y position
+ *  x : offset
+ *  y : offset
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void circleInternal( LCD128 *lcd, int xc, int yc, int x, int y )
+{
+  lcd128DrawPixel( lcd, xc + x, yc + y );
+
+  if ( y != 0 )
+  {
+    lcd128DrawPixel( lcd, xc + x, yc - y );
+  }
+
+  if ( x != 0 )
+  {
+    lcd128DrawPixel( lcd, xc - x, yc + y );
+    lcd128DrawPixel( lcd, xc - x, yc - y );
+  }
+
+  if ( x != y )
+  {
+    lcd128DrawPixel( lcd, xc + y, yc + x );
+    lcd128DrawPixel( lcd, xc - y, yc + x );
+
+    if ( x != 0 )
+    {
+      lcd128DrawPixel( lcd, xc + y, yc - x );
+      lcd128DrawPixel( lcd, xc - y, yc - x );
+    }
+  }
+}
+
+/*
+ * Draw a circle at given x, y with given radius using bresenham's circle algorithm
+ *
+ * Parameters:
+ *  xc: center x position
+ *  xy: center y position
+ *  r : radius
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawCircle( LCD128 *lcd, int xc, int yc, int r )
+{
+  int x = 0;
+  int y = r;
+  int decision = 5 - ( 4 * r );
+
+  if ( xc + r < lcd->clip.left || xc - r > lcd->clip.right || yc + r < lcd->clip.top || yc - r > lcd->clip.bottom )
+  {
+    return;
+  }
+
+  int inside = ( xc - r >= lcd->clip.left && xc + r <= lcd->clip.right && yc - r >= lcd->clip.top && yc + r <= lcd->clip.bottom );
+
+  while ( x <= y )
+  {
+    if ( inside )
+    {
+      lcd128CircleOctants( lcd, xc, yc, x, y );
+    }
+
+    else
+    {
+      circleInternal( lcd, xc, yc, x, y );
+    }
+
+    if ( decision > 0 )
+    {
+      y--;
+      decision -= 8 *  y;
+    }
+
+    x++;
+    
+    decision += 8 * x + 4;
+  }
+}
+
+/*
+ * Draw a circle at given x, y with given radius using bresenham's circle algorithm
+ *
+ * Parameters:
+ *  xc: center x position
+ *  xy: center y position
+ *  r : radius
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawFilledCircle( LCD128 *lcd, int xc, int yc, int r )
+{
+  int x = 0;
+  int y = r;
+  int decision = 5 - ( 4 * r );
+
+  while ( x <= y )
+  {
+    lcd128Span( lcd, xc - y, xc + y, yc + x, lcd->drawMode );
+
+    if ( x != 0 )
+    {
+      lcd128Span( lcd, xc - y, xc + y, yc - x, lcd->drawMode );
+    }
+
+    if ( decision > 0 )
+    {
+      if ( y != x ) //rows yc +- y are done widening, draw them once
+      {
+        lcd128Span( lcd, xc - x, xc + x, yc + y, lcd->drawMode );
+        lcd128Span( lcd, xc - x, xc + x, yc - y, lcd->drawMode );
+      }
+
+      y--;
+      decision -= 8 *  y;
+    }
+
+    x++;
+    
+    decision += 8 * x + 4;
+  }
+}
+
+/*
+ * Draw a triganle at given coordinates 
+ *
+ * Parameters:
+ * x1: first point x
+ * y1: first point y
+ * x2: second point x
+ * y2: second point y
+ * x3: third point x
+ * x3: third point y
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, int y3 )
+{
+  if ( lcd->drawMode == LCD128_DRAW_XOR ) //edges meeting at a sharp corner share more than it, so flip the gathered outline once
+  {
+    Lcd128Frame under = lcd->buffer;
+
+    memset( &lcd->buffer, 0, sizeof( lcd->buffer ) );
+    lcd->drawMode = LCD128_DRAW_SET;
+    lcd128DrawTriangle( lcd, x1, y1, x2, y2, x3, y3 );
+    lcd->drawMode = LCD128_DRAW_XOR;
+
+    for ( int y = 0; y < LCD128_HEIGHT; y++ )
+    {
+      lcd->buffer.longs[ y ][ 0 ] ^= under.longs[ y ][ 0 ];
+      lcd->buffer.longs[ y ][ 1 ] ^= under.longs[ y ][ 1 ];
+    }
+
+    return;
+  }
+
+  if ( x1 == x2 && y1 == y2 ) //two corners shared, the outline is one line
+  {
+    lcd128DrawLine( lcd, x1, y1, x3, y3 );
+    return;
+  }
+
+  if ( ( x2 == x3 && y2 == y3 ) || ( x3 == x1 && y3 == y1 ) )
+  {
+    lcd128DrawLine( lcd, x1, y1, x2, y2 );
+    return;
+  }
+
+  lcd128Line( lcd, x1, y1, x2, y2, 1 ); //each edge stops short of the next, so every corner is drawn once
+  lcd128Line( lcd, x2, y2, x3, y3, 1 );
+  lcd128Line( lcd, x3, y3, x1, y1, 1 );
+}
+
+/*
+ * Draw a triganle at given coordinates 
+ *
+ * Parameters:
+ * x1: first point x
+ * y1: first point y
+ * x2: second point x
+ * y2: second point y
+ * x3: third point x
+ * x3: third point y
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawFilledTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, int y3 )
+{
+  const int x[ 3 ] = { x1, x2, x3 };
+  const int y[ 3 ] = { y1, y2, y3 };
+
+  lcd128DrawFilledPolygon( lcd, x, y, 3 );
+}
+
+/*
+ * Fill a polygon, convex or not, by scanlines. Each edge is walked
+ * with an integer DDA of twice the crossing x at the row's pixel centers.
+ * Crossings are paired even-odd and filled as spans with the top-left
+ * rule: a pixel is drawn when its center is inside, or on a top or left
+ * edge, so polygons sharing an edge never draw it twice. Edges running
+ * past LCD128_GUARD rows are first cut there, which can shift them
+ * slightly as lcd128DrawLine's far ends are.
+ *
+ * Parameters:
+ *  lcd  : holds the frame buffer
+ *  x    : vertex x positions
+ *  y    : vertex y positions
+ *  count: number of vertices, 3 to LCD128_MAX_POLYGON
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128DrawFilledPolygon( LCD128 *lcd, const int *x, const int *y, int count )
+{
+  struct
+  {
+    int top;    // first row crossed
+    int bottom; // first row not crossed
+    int64_t dx;
+    int64_t dy;
+    int64_t n;  // 2 * crossing x * dy at the current row's center
+  } edges[ LCD128_MAX_POLYGON ];
+  int64_t crossings[ LCD128_MAX_POLYGON ];
+  int edgeCount = 0;
+  int minY = INT32_MAX;
+  int maxY = INT32_MIN;
+
+  if ( count < 3 || count > LCD128_MAX_POLYGON )
+  {
+    printf( "Failed: polygon needs 3 to %d vertices\n", LCD128_MAX_POLYGON );
+    return;
+  }
+
+  for ( int i = 0; i < count; i++ )
+  {
+    int x0 = x[ i ], y0 = y[ i ];
+    int x1 = x[ ( i + 1 ) % count ], y1 = y[ ( i + 1 ) % count ];
+
+    if ( y0 == y1 )
+    {
+      continue; //horizontal edges never cross a pixel center row
+    }
+
+    if ( y0 > y1 )
     {
-      y--;
-      decision -= 8 *  y;
+      int swap;
+      swap = x0; x0 = x1; x1 = swap;
+      swap = y0; y0 = y1; y1 = swap;
     }
 
-    x++;
-    
-    decision += 8 * x + 4;
+    if ( y1 <= -LCD128_GUARD || y0 >= LCD128_GUARD )
+    {
+      continue; //crosses no row that is ever scanned
+    }
+
+    if ( y0 < -LCD128_GUARD ) //too tall for exact 64-bit math, cut to the guard rows first
+    {
+      x0 += lcd128ScaleRound( ( int64_t )x1 - x0, -LCD128_GUARD - ( int64_t )y0, ( int64_t )y1 - y0 );
+      y0 = -LCD128_GUARD;
+    }
+
+    if ( y1 > LCD128_GUARD )
+    {
+      x1 = x0 + lcd128ScaleRound( ( int64_t )x1 - x0, LCD128_GUARD - ( int64_t )y0, ( int64_t )y1 - y0 );
+      y1 = LCD128_GUARD;
+    }
+
+    edges[ edgeCount ].top = y0;
+    edges[ edgeCount ].bottom = y1;
+    edges[ edgeCount ].dx = ( int64_t )x1 - x0;
+    edges[ edgeCount ].dy = ( int64_t )y1 - y0;
+    edges[ edgeCount ].n = 2 * ( int64_t )x0 * edges[ edgeCount ].dy + edges[ edgeCount ].dx; //at row y0 + 0.5
+    edgeCount++;
+
+    minY = MIN( minY, y0 );
+    maxY = MAX( maxY, y1 );
+  }
+
+  if ( edgeCount == 0 )
+  {
+    return;
+  }
+
+  int first = MAX( minY, lcd->clip.top );
+  int last = MIN( maxY, lcd->clip.bottom + 1 );
+
+  for ( int i = 0; i < edgeCount; i++ )
+  {
+    if ( edges[ i ].top < first )
+    {
+      edges[ i ].n += 2 * edges[ i ].dx * ( MIN( first, edges[ i ].bottom ) - edges[ i ].top ); //skip rows above the clip
+    }
+  }
+
+  for ( int row = first; row < last; row++ )
+  {
+    int crossingCount = 0;
+
+    for ( int i = 0; i < edgeCount; i++ )
+    {
+      if ( row < edges[ i ].top || row >= edges[ i ].bottom )
+      {
+        continue;
+      }
+
+      int64_t crossing = lcd128CeilDiv( edges[ i ].n - edges[ i ].dy, 2 * edges[ i ].dy ); //first pixel whose center is at or right of the edge
+      int at = crossingCount++;
+
+      while ( at > 0 && crossings[ at - 1 ] > crossing )
+      {
+        crossings[ at ] = crossings[ at - 1 ];
+        at--;
+      }
+
+      crossings[ at ] = crossing;
+      edges[ i ].n += 2 * edges[ i ].dx;
+    }
+
+    for ( int i = 0; i + 1 < crossingCount; i += 2 )
+    {
+      int64_t left = MAX( crossings[ i ], -1 );
+      int64_t right = MIN( crossings[ i + 1 ] - 1, LCD128_WIDTH );
+
+      lcd128Span( lcd, ( int )left, ( int )right, row, lcd->drawMode );
+    }
   }
 }
 
 /*
- * Draw a triganle at given coordinates 
+ * Read up to 16 bits of a bitmap row
  *
  * Parameters:
- * x1: first point x
- * y1: first point y
- * x2: second point x
- * y2: second point y
- * x3: third point x
- * x3: third point y
+ *  row  : first byte of the row
+ *  first: first pixel, 0 or more
+ *  count: pixels to read, 1 to 16
+ *
+ * Return:
+ *  the pixels, first in bit 15
+ **************************************************************
+ */
+
+static uint16_t lcd128ReadBits( const uint8_t *row, int first, int count )
+{
+  int start = first / 8;
+  int end = ( first + count - 1 ) / 8;
+  uint32_t bits = 0;
+
+  for ( int byte = start; byte <= end; byte++ ) //3 bytes at most, never past the last pixel read
+  {
+    bits = ( bits << 8 ) | row[ byte ];
+  }
+
+  bits >>= ( end + 1 ) * 8 - first - count;
+  bits &= ( 1 << count ) - 1;
+
+  return bits << ( 16 - count );
+}
+
+/*
+ * Reverse the order of 16 bits
+ *
+ * Parameters:
+ *  bits: bits to reverse
+ *
+ * Return:
+ *  bits with bit 15 swapped with bit 0, 14 with 1 and so on
+ **************************************************************
+ */
+
+static uint16_t lcd128Reverse16( uint16_t bits )
+{
+  bits = ( ( bits & 0x5555 ) << 1 ) | ( ( bits >> 1 ) & 0x5555 );
+  bits = ( ( bits & 0x3333 ) << 2 ) | ( ( bits >> 2 ) & 0x3333 );
+  bits = ( ( bits & 0x0F0F ) << 4 ) | ( ( bits >> 4 ) & 0x0F0F );
+
+  return ( bits << 8 ) | ( bits >> 8 );
+}
+
+/*
+ * Combine source pixels into a buffer word with a raster op
+ *
+ * Parameters:
+ *  word  : buffer word
+ *  source: source pixels, lined up with the word
+ *  mask  : pixels of the word to change
+ *  op    : LCD128_BLIT_COPY/OR/AND/XOR/ANDNOT
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, int y3 )
+static void lcd128RasterOp( uint16_t *word, uint16_t source, uint16_t mask, int op )
 {
-  lcd128DrawLine( lcd, x1, y1, x2, y2 );
-  lcd128DrawLine( lcd, x2, y2, x3, y3 );
-  lcd128DrawLine( lcd, x3, y3, x1, y1 );
+  switch ( op )
+  {
+    case LCD128_BLIT_OR:
+      *word |= source & mask;
+      break;
+
+    case LCD128_BLIT_AND:
+      *word &= source | ~mask;
+      break;
+
+    case LCD128_BLIT_XOR:
+      *word ^= source & mask;
+      break;
+
+    case LCD128_BLIT_ANDNOT:
+      *word &= ~( source & mask );
+      break;
+
+    default:
+      *word = ( *word & ~mask ) | ( source & mask );
+      break;
+  }
 }
 
 /*
- * Draw a triganle at given coordinates 
+ * Blit a whole bitmap
  *
  * Parameters:
- * x1: first point x
- * y1: first point y
- * x2: second point x
- * y2: second point y
- * x3: third point x
- * x3: third point y
+ *  lcd   : holds the frame buffer
+ *  bitmap: image to draw
+ *  x     : left on screen
+ *  y     : top on screen
+ *  op    : LCD128_BLIT_COPY/OR/AND/XOR/ANDNOT
+ *  flip  : LCD128_FLIP_X and/or LCD128_FLIP_Y, 0 for none
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128DrawFilledTriangle( LCD128 *lcd, int x1, int y1, int x2, int y2, int x3, int y3 )
+void lcd128Blit( LCD128 *lcd, const Lcd128Bitmap *bitmap, int x, int y, int op, int flip )
+{
+  lcd128BlitRect( lcd, bitmap, 0, 0, bitmap->width, bitmap->height, x, y, op, flip );
+}
+
+/*
+ * Blit part of a bitmap. The rect is clipped to the bitmap and the
+ * screen side to the clip rect up front; each buffer word then takes
+ * one read of up to 16 source pixels, shifted into place, and one
+ * raster op, so a 16 pixel wide row costs two words at any x.
+ *
+ * Parameters:
+ *  lcd   : holds the frame buffer
+ *  bitmap: image to draw from
+ *  sx    : left of the rect in the bitmap
+ *  sy    : top of the rect in the bitmap
+ *  width : rect width in pixels
+ *  height: rect height in pixels
+ *  x     : left on screen
+ *  y     : top on screen
+ *  op    : LCD128_BLIT_COPY/OR/AND/XOR/ANDNOT
+ *  flip  : LCD128_FLIP_X and/or LCD128_FLIP_Y, 0 for none
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128BlitRect( LCD128 *lcd, const Lcd128Bitmap *bitmap, int sx, int sy, int width, int height, int x, int y, int op, int flip )
 {
- int maxX = MAX( x1, MAX( x2, x3 ) );
- int minX = MIN( x1, MIN( x2, x3 ) );
- int maxY = MAX( y1, MAX( y2, y3 ) );
- int minY = MIN( y1, MIN( y2, y3 ) );
+  if ( sx < 0 )
+  {
+    width += sx;
+    x -= ( flip & LCD128_FLIP_X ) ? 0 : sx;
+    sx = 0;
+  }
 
- int vx1 = x2 - x1;
- int vy1 = y2 - y1;
+  if ( sy < 0 )
+  {
+    height += sy;
+    y -= ( flip & LCD128_FLIP_Y ) ? 0 : sy;
+    sy = 0;
+  }
 
- int vx2 = x3 - x1;
- int vy2 = y3 - y1;
+  if ( sx + width > bitmap->width )
+  {
+    x += ( flip & LCD128_FLIP_X ) ? sx + width - bitmap->width : 0;
+    width = bitmap->width - sx;
+  }
 
- for ( int x = minX; x <= maxX; x++ )
- {
-    for ( int y = minY; y <= maxY; y++)
-    {
-      int qx = x - x1;
-      int qy = y - y1;
+  if ( sy + height > bitmap->height )
+  {
+    y += ( flip & LCD128_FLIP_Y ) ? sy + height - bitmap->height : 0;
+    height = bitmap->height - sy;
+  }
+
+  int left   = MAX( x, lcd->clip.left );
+  int right  = MIN( x + width - 1, lcd->clip.right );
+  int top    = MAX( y, lcd->clip.top );
+  int bottom = MIN( y + height - 1, lcd->clip.bottom );
+
+  if ( left > right || top > bottom )
+  {
+    return;
+  }
 
-      float s = (float)( ( qx * vy2 ) - ( qy * vx2 ) ) / ( ( vx1 * vy2 ) - ( vy1 * vx2 ) );
-      float t = (float)( ( vx1 * qy ) - ( vy1 * qx ) ) / ( ( vx1 * vy2 ) - ( vy1 * vx2 ) );
+  for ( int row = top; row <= bottom; row++ )
+  {
+    int sourceRow = sy + ( ( flip & LCD128_FLIP_Y ) ? y + height - 1 - row : row - y );
+    const uint8_t *bits = bitmap->bits + sourceRow * bitmap->stride;
+    const uint8_t *mask = bitmap->mask ? bitmap->mask + sourceRow * bitmap->stride : NULL;
 
-      if ( ( s >= 0 ) && ( t >= 0 ) && ( s + t <= 1 ) )
+    for ( int word = left / 16; word <= right / 16; word++ )
+    {
+      int first = MAX( left, word * 16 );
+      int last = MIN( right, word * 16 + 15 );
+      int count = last - first + 1;
+      int from = ( flip & LCD128_FLIP_X ) ? sx + x + width - 1 - last : sx + first - x; //leftmost source pixel used
+      uint16_t source = lcd128ReadBits( bits, from, count );
+      uint16_t keep = mask ? lcd128ReadBits( mask, from, count ) : ( uint16_t )( 0xFFFF << ( 16 - count ) );
+
+      if ( flip & LCD128_FLIP_X )
       {
-        lcd128DrawPixel( lcd, x, y );
+        source = lcd128Reverse16( source ) << ( 16 - count );
+        keep = lcd128Reverse16( keep ) << ( 16 - count );
       }
+
+      lcd128RasterOp( &lcd->buffer.words[ row ][ word ], source >> ( first % 16 ), keep >> ( first % 16 ), op );
     }
- }
+
+    lcd->dirty[ row ] |= ( ( 2 << ( right / 16 ) ) - 1 ) & ~( ( 1 << ( left / 16 ) ) - 1 );
+    lcd->dirtyRows |= 1ULL << row;
+  }
 }
 
 /*
- * Update the lcd with contents of buffer
+ * Blit one frame of a sprite sheet
  *
  * Parameters:
- *  lcd   : holds the cursor info
- *  buffer: 128 x 64 array with the new contents of the screen
+ *  lcd  : holds the frame buffer
+ *  sheet: frames laid out in a grid
+ *  frame: frame number, left to right then top down
+ *  x    : left on screen
+ *  y    : top on screen
+ *  op   : LCD128_BLIT_COPY/OR/AND/XOR/ANDNOT
+ *  flip : LCD128_FLIP_X and/or LCD128_FLIP_Y, 0 for none
  *
  * Return:
  *  void
  **************************************************************
  */
 
-void lcd128UpdateScreen( LCD128 *lcd )
+void lcd128BlitFrame( LCD128 *lcd, const Lcd128Sheet *sheet, int frame, int x, int y, int op, int flip )
+{
+  int sx = ( frame % sheet->columns ) * sheet->frameWidth;
+  int sy = ( frame / sheet->columns ) * sheet->frameHeight;
+
+  if ( frame < 0 || sy >= sheet->bitmap->height )
+  {
+    printf( "Failed: sprite frame %d is not on the sheet\n", frame );
+    return;
+  }
+
+  lcd128BlitRect( lcd, sheet->bitmap, sx, sy, sheet->frameWidth, sheet->frameHeight, x, y, op, flip );
+}
+
+/*
+ * Send the words of one row that differ from current, or all of them
+ * when the GDRAM under the row is stale. Runs share one address set and
+ * the auto increment, bridging single unchanged words since those cost
+ * the same as a new address.
+ *
+ * Parameters:
+ *  lcd: holds the frame buffer
+ *  y  : dirty row
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcd128SendRow( LCD128 *lcd, int y )
 {
-  uint8_t temp, dataBit;
+  int changed = 0;
+
+  if ( ( lcd->staleRows >> y ) & 1 )
+  {
+    changed = ( 1 << LCD128_WORDS ) - 1;
+  }
 
-  if ( memcmp( lcd->current, lcd->buffer, sizeof( lcd->buffer ) ) != 0 )
+  else if ( !lcd128RowSame( &lcd->buffer, &lcd->current, y ) )
   {
-    for ( uint8_t y = 0; y < 64; y++ )
+    for ( int x = 0; x < LCD128_WORDS; x++ )
     {
-    
-      if ( y < 32 )
+      if ( ( lcd->dirty[ y ] & ( 1 << x ) ) && lcd->buffer.words[ y ][ x ] != lcd->current.words[ y ][ x ] )
       {
-        sendInstruction128( lcd, 0x80 | y );
-        sendInstruction128( lcd, 0x80 );
+        changed |= 1 << x;
       }
+    }
+  }
 
-      else
-      {
-        sendInstruction128( lcd, 0x80 | y - 32 );
-        sendInstruction128( lcd, 0x88 );
-      }
-  
-      for ( uint8_t x = 0; x < 8; x++ )
+  while ( changed )
+  {
+    int start = __builtin_ctz( changed );
+    int end = start;
+
+    while ( ( changed >> ( end + 1 ) ) & 3 ) //next word changed, or the one after it
+    {
+      end++;
+    }
+
+    lcd128GdramAddress( lcd, start, y );
+
+    for ( int x = start; x <= end; x++ )
+    {
+      sendData128( lcd, lcd->buffer.words[ y ][ x ] >> 8 );
+      sendData128( lcd, lcd->buffer.words[ y ][ x ] & 0xFF );
+      lcd->current.words[ y ][ x ] = lcd->buffer.words[ y ][ x ];
+    }
+
+    changed &= ~( ( 2 << end ) - 1 );
+  }
+
+  lcd->dirty[ y ] = 0;
+}
+
+/*
+ * Update the lcd with contents of buffer. Only words marked dirty and
+ * different from current are sent. After lcd128Scroll the stale rows go
+ * first, onto GDRAM lines the old offset still hides, and then the
+ * offset moves in one instruction. Unless retained, the buffer is then
+ * cleared, so every word still lit is marked dirty for the next frame.
+ *
+ * Parameters:
+ *  lcd: holds the frame buffer
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128UpdateScreen( LCD128 *lcd )
+{
+  uint64_t rows = lcd->dirtyRows;
+
+  if ( lcd->scrollShown != lcd->scroll )
+  {
+    uint64_t stale = lcd->staleRows;
+
+    while ( stale )
+    {
+      lcd128SendRow( lcd, __builtin_ctzll( stale ) );
+      stale &= stale - 1;
+    }
+
+    rows &= ~lcd->staleRows;
+
+    lcd128InstructionSet( lcd, 1 );
+
+    if ( !lcd->scrollRam )
+    {
+      sendInstruction128( lcd, LCD128_SCROLL_RAM | 1 ); //SR = 1, the next 0x40 sets the scroll offset
+      lcd->scrollRam = 1;
+    }
+
+    sendInstruction128( lcd, LCD128_SCROLL_ADDRESS | lcd->scroll );
+    lcd->scrollShown = lcd->scroll;
+  }
+
+  while ( rows )
+  {
+    lcd128SendRow( lcd, __builtin_ctzll( rows ) );
+    rows &= rows - 1;
+  }
+
+  lcd->staleRows = 0;
+  lcd->dirtyRows = 0;
+
+  if ( lcd->retained )
+  {
+    return;
+  }
+
+  for ( int y = 0; y < LCD128_HEIGHT; y++ )
+  {
+    if ( lcd128RowBlank( &lcd->current, y ) )
+    {
+      continue;
+    }
+
+    for ( int x = 0; x < LCD128_WORDS; x++ )
+    {
+      if ( lcd->current.words[ y ][ x ] )
       {
-        temp = lcd->buffer[ y ][ x ] >> 8;
-        sendData128( lcd, temp );
-        temp = lcd->buffer[ y ][ x ];
-        sendData128( lcd, temp );
+        lcd128MarkDirty( lcd, x * 16, y );
       }
     }
+  }
+
+  memset( &lcd->buffer, 0, sizeof( lcd->buffer ) );
+}
+
+/*
+ * Scroll the screen by moving the controller's vertical scroll offset
+ * instead of resending the frame. Each half of the screen is a 32 row
+ * window onto 64 GDRAM lines, so only the rows that cross between the
+ * halves and the rows scrolled in are sent by the next update, 2 per
+ * line scrolled. buffer and current move with the screen; rows scrolled
+ * in start blank for the caller to draw. The text overlay stays put.
+ *
+ * Parameters:
+ *  lcd  : lcd to scroll
+ *  lines: rows to move, > 0 = up with new rows at the bottom | < 0 = down
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcd128Scroll( LCD128 *lcd, int lines )
+{
+  const size_t row = sizeof( lcd->buffer.words[ 0 ] );
+  int n = lines < 0 ? -lines : lines;
+  uint64_t stale;
+
+  if ( n == 0 )
+  {
+    return;
+  }
+
+  if ( n > LCD128_HEIGHT )
+  {
+    n = LCD128_HEIGHT;
+  }
+
+  if ( lines > 0 )
+  {
+    memmove( lcd->buffer.words[ 0 ], lcd->buffer.words[ n ], ( LCD128_HEIGHT - n ) * row );
+    memmove( lcd->current.words[ 0 ], lcd->current.words[ n ], ( LCD128_HEIGHT - n ) * row );
+    memmove( lcd->dirty, lcd->dirty + n, LCD128_HEIGHT - n );
+    memset( lcd->buffer.words[ LCD128_HEIGHT - n ], 0, n * row );
+
+    lcd->dirtyRows = n < 64 ? lcd->dirtyRows >> n : 0;
+    lcd->staleRows = n < 64 ? lcd->staleRows >> n : 0;
+    stale = n < 32 ? ( ( 1ULL << n ) - 1 ) << ( 32 - n ) : 0xFFFFFFFFULL; //bottom of each half
+  }
+
+  else
+  {
+    memmove( lcd->buffer.words[ n ], lcd->buffer.words[ 0 ], ( LCD128_HEIGHT - n ) * row );
+    memmove( lcd->current.words[ n ], lcd->current.words[ 0 ], ( LCD128_HEIGHT - n ) * row );
+    memmove( lcd->dirty + n, lcd->dirty, LCD128_HEIGHT - n );
+    memset( lcd->buffer.words[ 0 ], 0, n * row );
+
+    lcd->dirtyRows = n < 64 ? lcd->dirtyRows << n : 0;
+    lcd->staleRows = n < 64 ? lcd->staleRows << n : 0;
+    stale = n < 32 ? ( 1ULL << n ) - 1 : 0xFFFFFFFFULL; //top of each half
+  }
 
-    memcpy( lcd->current, lcd->buffer, sizeof( lcd->current ) );
-    memset( lcd->buffer, 0, sizeof( lcd->buffer ) );
+  stale *= 0x100000001ULL; //same rows in both halves
+
+  for ( int y = 0; y < LCD128_HEIGHT; y++ )
+  {
+    if ( ( stale >> y ) & 1 )
+    {
+      lcd->dirty[ y ] = ( 1 << LCD128_WORDS ) - 1;
+    }
   }
+
+  lcd->staleRows |= stale;
+  lcd->dirtyRows |= stale;
+  lcd->scroll = ( lcd->scroll + lines % LCD128_HEIGHT + LCD128_HEIGHT ) & 63;
 }
 
 /*
@@ -654,9 +2290,37 @@ void lcd128UpdateScreen( LCD128 *lcd )
 
 LCD128 *initLcd128( int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7, int RST )
 {
-  LCD128 *lcd = ( LCD128* )malloc( sizeof( LCD128 ) );
+  return initLcd128RW( RS, -1, E, DB0, DB1, DB2, DB3, DB4, DB5, DB6, DB7, RST );
+}
+
+/*
+ * Initialize the lcd with the RW line wired, so it can be read back
+ * for calibration
+ *
+ * Parameters:
+ *  RS   : register select
+ *  RW   : read/write, -1 when tied to ground
+ *  E    : enable
+ *  DB0-7: data lines
+ *  RST  : reset
+ *
+ * Return:
+ *  LCD128 that has been initialized
+ **************************************************************
+ */
+
+LCD128 *initLcd128RW( int RS, int RW, int E, int DB0, int DB1, int DB2, int DB3, int DB4, int DB5, int DB6, int DB7, int RST )
+{
+  LCD128 *lcd;
+
+  if ( posix_memalign( ( void** )&lcd, 64, sizeof( LCD128 ) ) != 0 ) //frames sit on cache line boundaries
+  {
+    printf( "Failed: to allocate lcd128\n" );
+    return NULL;
+  }
 
   lcd->RS  =  RS;
+  lcd->RW  =  RW;
   lcd->E   =   E;
   lcd->DB0 = DB0;
   lcd->DB1 = DB1;
@@ -668,12 +2332,43 @@ LCD128 *initLcd128( int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4,
   lcd->DB7 = DB7;
   lcd->RST = RST;
   
-  lcd->cols = 16;
-  lcd->rows = 4;
+  lcd->cols = LCD128_TEXT_COLS;
+  lcd->rows = LCD128_TEXT_ROWS;
 
   lcd->cx = 0;
   lcd->cy = 0;
 
+  lcd->timing = safeTiming;
+  lcd->bus = NULL;
+  lcd->busSlot = -1;
+
+  lcd->extended = -1;
+  lcd->graphics = -1;
+  lcd->scroll = 0;
+  lcd->scrollShown = 0;
+  lcd->scrollRam = 0;
+
+  memset( lcd->overlay, ' ', sizeof( lcd->overlay ) );
+  memset( lcd->overlayShown, ' ', sizeof( lcd->overlayShown ) ); //the clear below blanks DDRAM
+
+  memset( &lcd->buffer, 0, sizeof( lcd->buffer ) );
+  memset( &lcd->current, 0, sizeof( lcd->current ) );
+  memset( lcd->dirty, 0, sizeof( lcd->dirty ) );
+  lcd->dirtyRows = 0;
+  lcd->staleRows = 0;
+  lcd->retained = 0;
+  lcd->drawMode = LCD128_DRAW_SET;
+
+  lcd->font = NULL;
+  lcd->fontScale = 1;
+  lcd->fontProportional = 0;
+
+  lcd->clip.left = 0;
+  lcd->clip.top = 0;
+  lcd->clip.right = LCD128_WIDTH - 1;
+  lcd->clip.bottom = LCD128_HEIGHT - 1;
+  lcd->clipDepth = 0;
+
   pinMode( lcd->RS , OUTPUT );
   pinMode( lcd->E  , OUTPUT );
   pinMode( lcd->DB0, OUTPUT );
@@ -686,6 +2381,12 @@ LCD128 *initLcd128( int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4,
   pinMode( lcd->DB7, OUTPUT );
   pinMode( lcd->RST, OUTPUT );
 
+  if ( lcd->RW >= 0 )
+  {
+    pinMode( lcd->RW, OUTPUT );
+    digitalWrite( lcd->RW, LOW );
+  }
+
   digitalWrite( lcd->RS , HIGH );
   digitalWrite( lcd->E  , LOW  );
   digitalWrite( lcd->RST, HIGH  );
@@ -697,6 +2398,8 @@ LCD128 *initLcd128( int RS, int E, int DB0, int DB1, int DB2, int DB3, int DB4,
   delay( 50 );
   
   sendInstruction128( lcd, 0x30 ); //Function Set 
+  lcd->extended = 0;
+  lcd->graphics = 0;
   sendInstruction128( lcd, 0x0C ); //Display Control
   sendInstruction128( lcd, 0x06 ); //Entry Mode
   sendInstruction128( lcd, 0x01 ); //Clear
@@ -0,0 +1,330 @@
+/*
+ * lcdBus.c:
+ *  Scheduler for several HD44780/ST7920 lcds sharing RS and DB0-DB7
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "jakestering.h"
+#include "lcd.h"
+#include "lcd128x64.h"
+#include "lcdBus.h"
+
+/*
+ * HD44780 transport for an lcd on a bus, queues instead of writing
+ *
+ * Parameters:
+ *  lcd      : lcd added with lcdBusAddLcd
+ *  rs       : HIGH = data | LOW = instruction
+ *  data     : byte to send
+ *  execMicro: execution time of the write
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void lcdBusLcdWrite( LCD *lcd, const int rs, const int data, const int execMicro )
+{
+  int execNanos = ( execMicro == LCD_EXEC_MICRO ) ? lcd->timing.gapNanos : execMicro * 1000;
+
+  lcdBusQueue( lcd->bus, lcd->busSlot, rs, data, execNanos );
+}
+
+/*
+ * Take a display slot for a device on the bus. lcdBusRun writes the data
+ * lines as one byte, so the device's DB0-DB7 must be the bus's 8
+ * consecutive pins.
+ *
+ * Parameters:
+ *  bus   : bus to join
+ *  RS    : the device's register select
+ *  DB    : the device's DB0-DB7
+ *  E     : the device's enable
+ *  timing: the device's bus timing
+ *
+ * Return:
+ *  slot number, -1 on failure
+ **************************************************************
+ */
+
+static int lcdBusAdd( LcdBus *bus, const int RS, const int DB[ 8 ], const int E, const BusTiming *timing )
+{
+  if ( RS != bus->RS )
+  {
+    printf( "Failed: lcd does not share RS with the bus\n" );
+    return -1;
+  }
+
+  for ( int i = 0; i < 8; i++ )
+  {
+    if ( DB[ i ] != bus->DB0 + i )
+    {
+      printf( "Failed: lcd DB%d is pin %d, the bus needs pin %d\n", i, DB[ i ], bus->DB0 + i );
+      return -1;
+    }
+  }
+
+  if ( bus->count == LCD_BUS_DISPLAYS )
+  {
+    printf( "Failed: lcd bus is full\n" );
+    return -1;
+  }
+
+  LcdBusDisplay *display = &bus->displays[ bus->count ];
+
+  display->E = E;
+  display->timing = timing;
+  display->readyAt = 0;
+  display->head = 0;
+  display->tail = 0;
+
+  return bus->count++;
+}
+
+/*
+ * Create a bus owning the shared pins
+ *
+ * Parameters:
+ *  RS : shared register select
+ *  DB0: first of 8 consecutive shared data pins
+ *
+ * Return:
+ *  LcdBus : that has been initialized
+ **************************************************************
+ */
+
+LcdBus* initLcdBus( int RS, int DB0 )
+{
+  LcdBus *bus = ( LcdBus* )calloc( 1, sizeof( LcdBus ) );
+
+  bus->RS = RS;
+  bus->DB0 = DB0;
+  bus->rs = HIGH;
+
+  pinMode( RS, OUTPUT );
+  digitalWrite( RS, HIGH );
+
+  for ( int pin = DB0; pin < DB0 + 8; pin++ )
+  {
+    pinMode( pin, OUTPUT );
+  }
+
+  return bus;
+}
+
+/*
+ * Move an initialized HD44780 onto the bus. From then on its writes are
+ * queued and only reach the display in lcdBusRun.
+ *
+ * Parameters:
+ *  bus: bus to join
+ *  lcd: parallel lcd, not in async mode
+ *
+ * Return:
+ *  slot number, -1 on failure
+ **************************************************************
+ */
+
+int lcdBusAddLcd( LcdBus *bus, LCD *lcd )
+{
+  if ( lcd->queue || lcd->i2cFd >= 0 )
+  {
+    printf( "Failed: only a synchronous parallel lcd can join a bus\n" );
+    return -1;
+  }
+
+  const int DB[ 8 ] = { lcd->DB0, lcd->DB1, lcd->DB2, lcd->DB3, lcd->DB4, lcd->DB5, lcd->DB6, lcd->DB7 };
+  int slot = lcdBusAdd( bus, lcd->RS, DB, lcd->E, &lcd->timing );
+
+  if ( slot < 0 )
+  {
+    return -1;
+  }
+
+  lcd->bus = bus;
+  lcd->busSlot = slot;
+  lcd->transportWrite = lcdBusLcdWrite;
+  lcd->transportFlush = NULL;
+
+  return slot;
+}
+
+/*
+ * Move an initialized ST7920 onto the bus. From then on its writes are
+ * queued and only reach the display in lcdBusRun.
+ *
+ * Parameters:
+ *  bus: bus to join
+ *  lcd: lcd to move
+ *
+ * Return:
+ *  slot number, -1 on failure
+ **************************************************************
+ */
+
+int lcdBusAddLcd128( LcdBus *bus, LCD128 *lcd )
+{
+  const int DB[ 8 ] = { lcd->DB0, lcd->DB1, lcd->DB2, lcd->DB3, lcd->DB4, lcd->DB5, lcd->DB6, lcd->DB7 };
+  int slot = lcdBusAdd( bus, lcd->RS, DB, lcd->E, &lcd->timing );
+
+  if ( slot < 0 )
+  {
+    return -1;
+  }
+
+  lcd->bus = bus;
+  lcd->busSlot = slot;
+
+  return slot;
+}
+
+/*
+ * Queue a write for one display. A full queue runs the bus first.
+ *
+ * Parameters:
+ *  bus      : bus the display is on
+ *  slot     : display slot
+ *  rs       : HIGH = data | LOW = instruction
+ *  data     : byte to send
+ *  execNanos: time the controller is busy after it
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdBusQueue( LcdBus *bus, int slot, int rs, int data, int execNanos )
+{
+  LcdBusDisplay *display = &bus->displays[ slot ];
+
+  if ( display->tail - display->head == LCD_BUS_QUEUE )
+  {
+    lcdBusRun( bus );
+  }
+
+  LcdBusWrite *write = &display->writes[ display->tail++ & ( LCD_BUS_QUEUE - 1 ) ];
+
+  write->value = ( rs ? 0x100 : 0 ) | ( data & 0xFF );
+  write->execNanos = execNanos;
+}
+
+/*
+ * Count the writes still queued
+ *
+ * Parameters:
+ *  bus: bus to check
+ *
+ * Return:
+ *  number of queued writes
+ **************************************************************
+ */
+
+int lcdBusPending( LcdBus *bus )
+{
+  int pending = 0;
+
+  for ( int slot = 0; slot < bus->count; slot++ )
+  {
+    pending += bus->displays[ slot ].tail - bus->displays[ slot ].head;
+  }
+
+  return pending;
+}
+
+/*
+ * Send every queued write. Each turn goes to the next display, round
+ * robin, whose controller is ready; the bus only idles when every
+ * display with work left is busy.
+ *
+ * Parameters:
+ *  bus: bus to run
+ *
+ * Return:
+ *  number of writes sent
+ **************************************************************
+ */
+
+int lcdBusRun( LcdBus *bus )
+{
+  int writes = 0;
+
+  for (;;)
+  {
+    uint64_t now = nanos();
+    uint64_t soonest = UINT64_MAX;
+    LcdBusDisplay *display = NULL;
+
+    for ( int i = 0; i < bus->count; i++ )
+    {
+      int slot = ( bus->next + i ) % bus->count;
+      LcdBusDisplay *candidate = &bus->displays[ slot ];
+
+      if ( candidate->head == candidate->tail )
+      {
+        continue;
+      }
+
+      if ( candidate->readyAt <= now )
+      {
+        display = candidate;
+        bus->next = slot + 1;
+        break;
+      }
+
+      soonest = MIN( soonest, candidate->readyAt );
+    }
+
+    if ( display == NULL )
+    {
+      if ( soonest == UINT64_MAX )
+      {
+        return writes;
+      }
+
+      delayNano( soonest - now ); //every display with work left is busy
+      continue;
+    }
+
+    LcdBusWrite *write = &display->writes[ display->head++ & ( LCD_BUS_QUEUE - 1 ) ];
+    int rs = ( write->value & 0x100 ) ? HIGH : LOW;
+
+    if ( rs != bus->rs )
+    {
+      digitalWrite( bus->RS, rs );
+      bus->rs = rs;
+    }
+
+    digitalWriteByte( write->value & 0xFF, bus->DB0, bus->DB0 + 7 );
+
+    digitalWrite( display->E, HIGH );
+    delayNano( display->timing->enableNanos );
+    digitalWrite( display->E, LOW );
+    delayNano( display->timing->holdNanos );
+
+    display->readyAt = nanos() + write->execNanos;
+    writes++;
+  }
+}
+
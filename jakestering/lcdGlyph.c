@@ -0,0 +1,340 @@
+/*
+ * lcdGlyph.c:
+ *  CGRAM glyph manager and pseudo-graphics canvas for HD44780 lcd driver
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "lcd.h"
+#include "lcdGlyph.h"
+#include "jakestering.h"
+
+#define GLYPH_FULL 0x1F1F1F1F1F1F1F1FULL //every row of a cell set
+
+/*
+ * Check whether a CGRAM slot is still showing on the virtual screen
+ *
+ * Parameters:
+ *  lcd : lcd to check
+ *  slot: CGRAM slot
+ *
+ * Return:
+ *  1 if any cell uses the slot, otherwise 0
+ **************************************************************
+ */
+
+static int glyphVisible( LCD *lcd, int slot )
+{
+  for ( int y = 0; y < lcd->rows; y++ )
+  {
+    for ( int x = 0; x < lcd->cols; x++ )
+    {
+      if ( lcd->screen[ y ][ x ] < 16 && ( lcd->screen[ y ][ x ] & 0b111 ) == slot )
+      {
+        return 1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Get the character code for a glyph, loading it into CGRAM only when no
+ * slot holds it yet. The bitmap itself is the lookup key, so a hit costs
+ * no bus traffic. On a miss the least recently used slot that is not on
+ * the virtual screen is replaced. In async mode the writer thread owns the
+ * screen, so a miss with every slot taken first waits on lcdAsyncFence.
+ * Call from one thread.
+ *
+ * Parameters:
+ *  lcd   : lcd owning CGRAM
+ *  bitmap: 8 rows of 5 pixels, row 0 in the low byte
+ *
+ * Return:
+ *  character code 8-15 (safe inside strings), -1 if every slot is on screen
+ **************************************************************
+ */
+
+int lcdGlyphBitmap( LCD *lcd, uint64_t bitmap )
+{
+  int victim = -1;
+
+  bitmap &= GLYPH_FULL;
+  lcd->glyphClock++;
+
+  for ( int slot = 0; slot < LCD_GLYPH_SLOTS; slot++ )
+  {
+    if ( lcd->glyphUsed[ slot ] && lcd->glyphs[ slot ] == bitmap )
+    {
+      lcd->glyphUsed[ slot ] = lcd->glyphClock;
+      return 8 | slot;
+    }
+  }
+
+  for ( int slot = 0; slot < LCD_GLYPH_SLOTS && victim < 0; slot++ )
+  {
+    if ( lcd->glyphUsed[ slot ] == 0 )
+    {
+      victim = slot;
+    }
+  }
+
+  if ( victim < 0 )
+  {
+    if ( lcd->queue )
+    {
+      lcdAsyncFence( lcd ); //the writer owns the screen, wait until it has applied every queued write, releases included
+    }
+
+    for ( int slot = 0; slot < LCD_GLYPH_SLOTS; slot++ )
+    {
+      if ( ( victim < 0 || lcd->glyphUsed[ slot ] < lcd->glyphUsed[ victim ] ) && !glyphVisible( lcd, slot ) )
+      {
+        victim = slot;
+      }
+    }
+  }
+
+  if ( victim < 0 )
+  {
+    return -1;
+  }
+
+  lcdLoadGlyph( lcd, victim, bitmap );
+  lcd->glyphs[ victim ] = bitmap;
+  lcd->glyphUsed[ victim ] = lcd->glyphClock;
+
+  return 8 | victim;
+}
+
+/*
+ * Same as lcdGlyphBitmap, taking the rows as an array
+ *
+ * Parameters:
+ *  lcd : lcd owning CGRAM
+ *  rows: 8 rows, the low 5 bits of each are the pixels
+ *
+ * Return:
+ *  character code 8-15, -1 if every slot is on screen
+ **************************************************************
+ */
+
+int lcdGlyph( LCD *lcd, const unsigned char rows[ LCD_GLYPH_HEIGHT ] )
+{
+  uint64_t bitmap = 0;
+
+  for ( int row = 0; row < LCD_GLYPH_HEIGHT; row++ )
+  {
+    bitmap |= ( uint64_t )( rows[ row ] & 0b11111 ) << ( row * 8 );
+  }
+
+  return lcdGlyphBitmap( lcd, bitmap );
+}
+
+/*
+ * Set up an empty canvas
+ *
+ * Parameters:
+ *  canvas   : canvas to set up
+ *  cellsWide: width in characters
+ *  cellsHigh: height in characters
+ *
+ * Return:
+ *  0 on success, -1 if it needs more than 8 cells
+ **************************************************************
+ */
+
+int lcdCanvasInit( LcdCanvas *canvas, int cellsWide, int cellsHigh )
+{
+  if ( cellsWide < 1 || cellsHigh < 1 || cellsWide * cellsHigh > LCD_CANVAS_MAX_CELLS )
+  {
+    return -1;
+  }
+
+  canvas->cellsWide = cellsWide;
+  canvas->cellsHigh = cellsHigh;
+  lcdCanvasClear( canvas );
+
+  return 0;
+}
+
+/*
+ * Clear every pixel of a canvas
+ *
+ * Parameters:
+ *  canvas: canvas to clear
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdCanvasClear( LcdCanvas *canvas )
+{
+  memset( canvas->cells, 0, sizeof( canvas->cells ) );
+}
+
+/*
+ * Set or clear one pixel of a canvas
+ *
+ * Parameters:
+ *  canvas: canvas to draw on
+ *  x     : horizontal pixel, 5 per cell
+ *  y     : vertical pixel, 8 per cell
+ *  value : 1 = set | 0 = clear
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdCanvasSetPixel( LcdCanvas *canvas, int x, int y, int value )
+{
+  if ( x < 0 || y < 0 || x >= canvas->cellsWide * LCD_GLYPH_WIDTH || y >= canvas->cellsHigh * LCD_GLYPH_HEIGHT )
+  {
+    return;
+  }
+
+  int cell = ( y / LCD_GLYPH_HEIGHT ) * canvas->cellsWide + x / LCD_GLYPH_WIDTH;
+  uint64_t bit = 1ULL << ( ( y % LCD_GLYPH_HEIGHT ) * 8 + ( LCD_GLYPH_WIDTH - 1 - x % LCD_GLYPH_WIDTH ) );
+
+  if ( value )
+  {
+    canvas->cells[ cell ] |= bit;
+  }
+
+  else
+  {
+    canvas->cells[ cell ] &= ~bit;
+  }
+}
+
+/*
+ * Put a canvas on the virtual screen. Blank and full cells use ROM
+ * characters; the rest go through the glyph cache, so cells that did not
+ * change since the last draw are not uploaded again. Send with lcdFlush.
+ *
+ * Parameters:
+ *  lcd   : lcd to draw on
+ *  canvas: canvas to draw
+ *  x     : column of the top left cell
+ *  y     : row of the top left cell
+ *
+ * Return:
+ *  0 on success, -1 if CGRAM ran out of free slots
+ **************************************************************
+ */
+
+int lcdCanvasDraw( LCD *lcd, LcdCanvas *canvas, int x, int y )
+{
+  int result = 0;
+
+  for ( int row = 0; row < canvas->cellsHigh; row++ ) //release the slots of the previous draw first
+  {
+    for ( int col = 0; col < canvas->cellsWide; col++ )
+    {
+      lcdScreenPutChar( lcd, x + col, y + row, ' ' );
+    }
+  }
+
+  for ( int row = 0; row < canvas->cellsHigh; row++ )
+  {
+    for ( int col = 0; col < canvas->cellsWide; col++ )
+    {
+      uint64_t bitmap = canvas->cells[ row * canvas->cellsWide + col ];
+      int code;
+
+      if ( bitmap == 0 )
+      {
+        continue;
+      }
+
+      code = ( bitmap == GLYPH_FULL ) ? LCD_FULL_BLOCK : lcdGlyphBitmap( lcd, bitmap );
+
+      if ( code < 0 )
+      {
+        result = -1;
+        continue;
+      }
+
+      lcdScreenPutChar( lcd, x + col, y + row, code );
+    }
+  }
+
+  return result;
+}
+
+/*
+ * Put a horizontal bar on the virtual screen with single pixel steps.
+ * Only the partially filled end cell needs a custom character.
+ *
+ * Parameters:
+ *  lcd  : lcd to draw on
+ *  x    : first column of the bar
+ *  y    : row
+ *  width: length of the bar in characters
+ *  value: current value
+ *  max  : value that fills the bar
+ *
+ * Return:
+ *  0 on success, -1 if CGRAM ran out of free slots
+ **************************************************************
+ */
+
+int lcdBarGraph( LCD *lcd, int x, int y, int width, int value, int max )
+{
+  int pixels = ( max > 0 ) ? ( int )( ( long long )MAX( 0, MIN( value, max ) ) * width * LCD_GLYPH_WIDTH / max ) : 0;
+  int result = 0;
+
+  for ( int col = 0; col < width; col++ )
+  {
+    int fill = MIN( MAX( pixels - col * LCD_GLYPH_WIDTH, 0 ), LCD_GLYPH_WIDTH );
+    int code = ' ';
+
+    if ( fill == LCD_GLYPH_WIDTH )
+    {
+      code = LCD_FULL_BLOCK;
+    }
+
+    else if ( fill > 0 )
+    {
+      uint64_t row = ( 0b11111 << ( LCD_GLYPH_WIDTH - fill ) ) & 0b11111;
+
+      lcdScreenPutChar( lcd, x + col, y, ' ' );
+      code = lcdGlyphBitmap( lcd, row * 0x0101010101010101ULL );
+
+      if ( code < 0 )
+      {
+        result = -1;
+        code = ' ';
+      }
+    }
+
+    lcdScreenPutChar( lcd, x + col, y, code );
+  }
+
+  return result;
+}
+
@@ -0,0 +1,398 @@
+/*
+ * lcdModel.c:
+ *  Behavioural HD44780 model for checking bus timing against the datasheet
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "jakestering.h"
+#include "lcdModel.h"
+
+static const char *violationNames[ LCD_VIOLATION_KINDS ] = { "tAS", "PWEH", "tH", "tDSW", "tcycE", "exec" };
+
+/*
+ * Count a timing violation, keeping the details of the first few
+ *
+ * Parameters:
+ *  model   : model that saw it
+ *  index   : bus log entry
+ *  kind    : LCD_VIOLATION_*
+ *  actual  : ns measured
+ *  required: ns needed
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void modelViolation( LcdModel *model, int index, int kind, uint64_t actual, int required )
+{
+  model->counts[ kind ]++;
+
+  if ( model->keptCount < LCD_MODEL_KEEP )
+  {
+    LcdViolation *violation = &model->kept[ model->keptCount++ ];
+
+    violation->index = index;
+    violation->kind = kind;
+    violation->actual = ( int )MIN( actual, 0x7FFFFFFF );
+    violation->required = required;
+  }
+}
+
+/*
+ * Move the address counter after a read, write or cursor shift
+ *
+ * Parameters:
+ *  model: model to step
+ *  up   : 1 = increment | 0 = decrement
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void modelStep( LcdModel *model, int up )
+{
+  if ( model->cgramMode )
+  {
+    model->address = ( model->address + ( up ? 1 : -1 ) ) & 0b111111;
+  }
+
+  else if ( up )
+  {
+    model->address = ( model->address == 0x27 ) ? 0x40 : ( model->address == 0x67 ) ? 0x00 : ( model->address + 1 ) & 0b1111111;
+  }
+
+  else
+  {
+    model->address = ( model->address == 0x40 ) ? 0x27 : ( model->address == 0x00 ) ? 0x67 : model->address - 1;
+  }
+}
+
+/*
+ * Carry out a byte latched on the falling edge of E
+ *
+ * Parameters:
+ *  model: model receiving it
+ *  rs   : 1 = data | 0 = instruction
+ *  data : byte on DB0-DB7
+ *  nanos: time of the falling edge
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void modelLatch( LcdModel *model, int rs, int data, uint64_t nanos )
+{
+  int exec = model->timing.exec;
+
+  if ( rs )
+  {
+    if ( model->cgramMode )
+    {
+      model->cgram[ model->address & 0b111111 ] = data;
+    }
+
+    else
+    {
+      model->ddram[ model->address & 0b1111111 ] = data;
+
+      if ( model->shiftOnWrite ) //entry mode S: the display follows the cursor
+      {
+        model->shift = ( model->shift + ( model->increment ? 1 : 39 ) ) % 40;
+      }
+    }
+
+    modelStep( model, model->increment );
+  }
+
+  else if ( data & 0b10000000 )
+  {
+    model->address = data & 0b01111111;
+    model->cgramMode = 0;
+  }
+
+  else if ( data & 0b01000000 )
+  {
+    model->address = data & 0b00111111;
+    model->cgramMode = 1;
+  }
+
+  else if ( data & 0b00100000 )
+  {
+    model->function = data;
+  }
+
+  else if ( data & 0b00010000 )
+  {
+    if ( data & 0b00001000 )
+    {
+      model->shift = ( model->shift + ( ( data & 0b00000100 ) ? 39 : 1 ) ) % 40;
+    }
+
+    else
+    {
+      modelStep( model, data & 0b00000100 );
+    }
+  }
+
+  else if ( data & 0b00001000 )
+  {
+    model->control = data;
+  }
+
+  else if ( data & 0b00000100 )
+  {
+    model->increment = ( data & 0b00000010 ) != 0;
+    model->shiftOnWrite = ( data & 0b00000001 ) != 0;
+  }
+
+  else if ( data & 0b00000010 )
+  {
+    model->address = 0;
+    model->shift = 0;
+    model->cgramMode = 0;
+    exec = model->timing.execHome;
+  }
+
+  else if ( data & 0b00000001 )
+  {
+    memset( model->ddram, ' ', sizeof( model->ddram ) );
+    model->address = 0;
+    model->shift = 0;
+    model->cgramMode = 0;
+    model->increment = 1;
+    exec = model->timing.execHome;
+  }
+
+  model->busyUntil = nanos + exec;
+  model->writes++;
+}
+
+/*
+ * Create a model of an lcd wired to the given pins, with datasheet timing
+ *
+ * Parameters:
+ *  RS : register select
+ *  RW : read/write, -1 when tied to ground
+ *  E  : enable
+ *  DB0: first of 8 consecutive data pins
+ *
+ * Return:
+ *  LcdModel : that has been initialized, NULL on failure
+ **************************************************************
+ */
+
+LcdModel* initLcdModel( int RS, int RW, int E, int DB0 )
+{
+  LcdModel *model = ( LcdModel* )calloc( 1, sizeof( LcdModel ) );
+
+  if ( model == NULL )
+  {
+    printf( "Failed: to allocate lcd model\n" );
+    return NULL;
+  }
+
+  model->RS = RS;
+  model->RW = RW;
+  model->E = E;
+  model->DB0 = DB0;
+
+  model->timing.tAS = LCD_T_AS;
+  model->timing.PWEH = LCD_T_PWEH;
+  model->timing.tH = LCD_T_H;
+  model->timing.tDSW = LCD_T_DSW;
+  model->timing.tcycE = LCD_T_CYCE;
+  model->timing.exec = LCD_T_EXEC;
+  model->timing.execHome = LCD_T_EXEC_HOME;
+
+  memset( model->ddram, ' ', sizeof( model->ddram ) );
+  model->increment = 1;
+
+  return model;
+}
+
+/*
+ * Feed a bus write log to the model. State carries over between calls,
+ * so the log can be cleared and run again in pieces.
+ *
+ * Parameters:
+ *  model: model to drive
+ *  log  : log from setupFakeIO
+ *
+ * Return:
+ *  violations found in this log
+ **************************************************************
+ */
+
+int lcdModelRun( LcdModel *model, const BusLog *log )
+{
+  uint32_t addressMask = ( 1 << model->RS ) | ( ( model->RW >= 0 ) ? 1 << model->RW : 0 );
+  uint32_t dataMask = 0xFF << model->DB0;
+  uint32_t enableMask = 1 << model->E;
+  int before = lcdModelViolations( model );
+
+  for ( int i = 0; i < log->count; i++ )
+  {
+    const BusWrite *write = &log->writes[ i ];
+    uint32_t changed = model->levels ^ write->levels;
+    int enableHigh = ( model->levels & enableMask ) != 0;
+    uint64_t t = write->nanos;
+
+    model->levels = write->levels;
+
+    if ( changed & addressMask )
+    {
+      if ( enableHigh )
+      {
+        modelViolation( model, i, LCD_VIOLATION_TH, 0, model->timing.tH ); //changed under E, no hold at all
+      }
+
+      else if ( model->fall && t - model->fall < ( uint64_t )model->timing.tH )
+      {
+        modelViolation( model, i, LCD_VIOLATION_TH, t - model->fall, model->timing.tH );
+      }
+
+      model->addressChanged = t;
+    }
+
+    if ( changed & dataMask )
+    {
+      if ( !enableHigh && model->fall && t - model->fall < ( uint64_t )model->timing.tH )
+      {
+        modelViolation( model, i, LCD_VIOLATION_TH, t - model->fall, model->timing.tH );
+      }
+
+      model->dataChanged = t;
+    }
+
+    if ( !( changed & enableMask ) )
+    {
+      continue;
+    }
+
+    int rs = ( model->levels >> model->RS ) & 1;
+    int read = model->RW >= 0 && ( ( model->levels >> model->RW ) & 1 );
+
+    if ( model->levels & enableMask )
+    {
+      if ( t - model->addressChanged < ( uint64_t )model->timing.tAS )
+      {
+        modelViolation( model, i, LCD_VIOLATION_TAS, t - model->addressChanged, model->timing.tAS );
+      }
+
+      if ( model->rise && t - model->rise < ( uint64_t )model->timing.tcycE )
+      {
+        modelViolation( model, i, LCD_VIOLATION_TCYCE, t - model->rise, model->timing.tcycE );
+      }
+
+      if ( t < model->busyUntil && !( read && !rs ) ) //only the busy flag may be read while busy
+      {
+        modelViolation( model, i, LCD_VIOLATION_EXEC, t - model->fall, model->busyUntil - model->fall );
+      }
+
+      model->rise = t;
+    }
+
+    else
+    {
+      if ( t - model->rise < ( uint64_t )model->timing.PWEH )
+      {
+        modelViolation( model, i, LCD_VIOLATION_PWEH, t - model->rise, model->timing.PWEH );
+      }
+
+      if ( !read )
+      {
+        if ( t - model->dataChanged < ( uint64_t )model->timing.tDSW )
+        {
+          modelViolation( model, i, LCD_VIOLATION_TDSW, t - model->dataChanged, model->timing.tDSW );
+        }
+
+        modelLatch( model, rs, ( model->levels & dataMask ) >> model->DB0, t );
+      }
+
+      model->fall = t;
+    }
+  }
+
+  return lcdModelViolations( model ) - before;
+}
+
+/*
+ * Total violations seen by the model
+ *
+ * Parameters:
+ *  model: model to check
+ *
+ * Return:
+ *  number of violations
+ **************************************************************
+ */
+
+int lcdModelViolations( LcdModel *model )
+{
+  int total = 0;
+
+  for ( int kind = 0; kind < LCD_VIOLATION_KINDS; kind++ )
+  {
+    total += model->counts[ kind ];
+  }
+
+  return total;
+}
+
+/*
+ * Print the violation counts and the first violations in detail
+ *
+ * Parameters:
+ *  model: model to report
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdModelReport( LcdModel *model )
+{
+  printf( "lcd model: %d bytes latched, %d violations\n", model->writes, lcdModelViolations( model ) );
+
+  for ( int kind = 0; kind < LCD_VIOLATION_KINDS; kind++ )
+  {
+    if ( model->counts[ kind ] )
+    {
+      printf( "  %-5s: %d\n", violationNames[ kind ], model->counts[ kind ] );
+    }
+  }
+
+  for ( int i = 0; i < model->keptCount; i++ )
+  {
+    LcdViolation *violation = &model->kept[ i ];
+
+    printf( "  write %d: %s %d ns, needs %d ns\n", violation->index, violationNames[ violation->kind ], violation->actual, violation->required );
+  }
+}
+
@@ -0,0 +1,665 @@
+/*
+ * lcdTerm.c:
+ *  VT100/ANSI terminal emulator for HD44780 lcd driver
+ *
+ * Copyright (c) 2023 Jacob Kellum <jkellum819@gmail.com>
+ *************************************************************************
+ * This file is apart of Jakestering:
+ *    https://github.com/McCoy1701/Jakestering
+ *
+ * Jakestering is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Jakestering is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Jakestering; if not, see <http://www.gnu.org/licenses/>.
+ * ***********************************************************************
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "lcd.h"
+#include "lcdTerm.h"
+#include "jakestering.h"
+
+#define TERM_NORMAL 0
+#define TERM_ESCAPE 1
+#define TERM_CSI    2
+
+/*
+ * Get a row of the live screen
+ *
+ * Parameters:
+ *  term: terminal
+ *  row : screen row
+ *
+ * Return:
+ *  the row's cells
+ **************************************************************
+ */
+
+static unsigned char *termLine( LcdTerm *term, int row )
+{
+  return term->lines[ ( term->top + row ) % LCD_TERM_LINES ];
+}
+
+/*
+ * Blank part of a screen row
+ *
+ * Parameters:
+ *  term: terminal
+ *  row : screen row
+ *  from: first column
+ *  to  : last column
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void termClear( LcdTerm *term, int row, int from, int to )
+{
+  if ( from <= to )
+  {
+    memset( termLine( term, row ) + from, ' ', to - from + 1 );
+  }
+}
+
+/*
+ * Move down a row, scrolling at the bottom
+ *
+ * Parameters:
+ *  term: terminal
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void termIndex( LcdTerm *term )
+{
+  if ( term->cy == term->rows - 1 )
+  {
+    lcdTermScroll( term, 1 );
+  }
+
+  else
+  {
+    term->cy++;
+  }
+}
+
+/*
+ * Move the cursor, clamped to the screen
+ *
+ * Parameters:
+ *  term: terminal
+ *  x   : column
+ *  y   : row
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void termMove( LcdTerm *term, int x, int y )
+{
+  term->cx = MAX( 0, MIN( x, term->cols - 1 ) );
+  term->cy = MAX( 0, MIN( y, term->rows - 1 ) );
+  term->wrapPending = 0;
+}
+
+/*
+ * Get a numeric parameter of the current escape sequence
+ *
+ * Parameters:
+ *  term    : terminal
+ *  index   : parameter number
+ *  fallback: value when it's missing or 0
+ *
+ * Return:
+ *  the parameter
+ **************************************************************
+ */
+
+static int termParam( LcdTerm *term, int index, int fallback )
+{
+  if ( index < term->paramCount && index < LCD_TERM_PARAMS && term->params[ index ] > 0 )
+  {
+    return term->params[ index ];
+  }
+
+  return fallback;
+}
+
+/*
+ * Carry out a CSI sequence once its final byte arrives
+ *
+ * Parameters:
+ *  term : terminal
+ *  final: final byte
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+static void termCsi( LcdTerm *term, unsigned char final )
+{
+  int count = termParam( term, 0, 1 );
+
+  if ( term->privateMode )
+  {
+    if ( ( final == 'h' || final == 'l' ) && termParam( term, 0, 0 ) == 25 ) //show/hide cursor
+    {
+      term->cursor = ( final == 'h' );
+      lcdCursor( term->lcd, term->cursor );
+    }
+    return;
+  }
+
+  switch ( final )
+  {
+    case 'A':
+      termMove( term, term->cx, term->cy - count );
+      break;
+
+    case 'B':
+    case 'e':
+      termMove( term, term->cx, term->cy + count );
+      break;
+
+    case 'C':
+    case 'a':
+      termMove( term, term->cx + count, term->cy );
+      break;
+
+    case 'D':
+      termMove( term, term->cx - count, term->cy );
+      break;
+
+    case 'E':
+      termMove( term, 0, term->cy + count );
+      break;
+
+    case 'F':
+      termMove( term, 0, term->cy - count );
+      break;
+
+    case 'G':
+    case '`':
+      termMove( term, count - 1, term->cy );
+      break;
+
+    case 'd':
+      termMove( term, term->cx, count - 1 );
+      break;
+
+    case 'H':
+    case 'f':
+      termMove( term, termParam( term, 1, 1 ) - 1, count - 1 );
+      break;
+
+    case 'J':
+      switch ( termParam( term, 0, 0 ) )
+      {
+        case 0:
+          termClear( term, term->cy, term->cx, term->cols - 1 );
+          for ( int row = term->cy + 1; row < term->rows; row++ )
+          {
+            termClear( term, row, 0, term->cols - 1 );
+          }
+          break;
+
+        case 1:
+          termClear( term, term->cy, 0, term->cx );
+          for ( int row = 0; row < term->cy; row++ )
+          {
+            termClear( term, row, 0, term->cols - 1 );
+          }
+          break;
+
+        default:
+          for ( int row = 0; row < term->rows; row++ )
+          {
+            termClear( term, row, 0, term->cols - 1 );
+          }
+          break;
+      }
+      break;
+
+    case 'K':
+      switch ( termParam( term, 0, 0 ) )
+      {
+        case 0:
+          termClear( term, term->cy, term->cx, term->cols - 1 );
+          break;
+
+        case 1:
+          termClear( term, term->cy, 0, term->cx );
+          break;
+
+        default:
+          termClear( term, term->cy, 0, term->cols - 1 );
+          break;
+      }
+      break;
+
+    case 'S':
+      lcdTermScroll( term, count );
+      break;
+
+    case 'T':
+      lcdTermScroll( term, -count );
+      break;
+
+    case 's':
+      term->savedX = term->cx;
+      term->savedY = term->cy;
+      break;
+
+    case 'u':
+      termMove( term, term->savedX, term->savedY );
+      break;
+
+    default: //colours and modes have no meaning on the lcd
+      break;
+  }
+}
+
+/*
+ * Create a terminal covering the whole lcd
+ *
+ * Parameters:
+ *  lcd: lcd to render to
+ *
+ * Return:
+ *  LcdTerm : that has been initialized
+ **************************************************************
+ */
+
+LcdTerm* initLcdTerm( LCD *lcd )
+{
+  LcdTerm *term = ( LcdTerm* )calloc( 1, sizeof( LcdTerm ) );
+
+  if ( term == NULL )
+  {
+    printf( "Failed: to allocate lcd terminal\n" );
+    return NULL;
+  }
+
+  term->lcd = lcd;
+  term->rows = lcd->rows;
+  term->cols = lcd->cols;
+
+  memset( term->lines, ' ', sizeof( term->lines ) ); //shown stays 0 so the first render covers every cell
+
+  return term;
+}
+
+/*
+ * Feed one byte to the terminal. Nothing is sent until lcdTermRender.
+ * A line feed also returns the carriage, since output through a pipe
+ * never gets the tty's CR added.
+ *
+ * Parameters:
+ *  term     : terminal
+ *  character: byte of output
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdTermPutChar( LcdTerm *term, unsigned char character )
+{
+  if ( term->state == TERM_ESCAPE )
+  {
+    term->state = TERM_NORMAL;
+
+    switch ( character )
+    {
+      case '[':
+        term->state = TERM_CSI;
+        term->paramCount = 0;
+        term->privateMode = 0;
+        memset( term->params, 0, sizeof( term->params ) );
+        break;
+
+      case '7':
+        term->savedX = term->cx;
+        term->savedY = term->cy;
+        break;
+
+      case '8':
+        termMove( term, term->savedX, term->savedY );
+        break;
+
+      case 'D':
+        termIndex( term );
+        break;
+
+      case 'E':
+        term->cx = 0;
+        termIndex( term );
+        break;
+
+      case 'M':
+        if ( term->cy == 0 )
+        {
+          lcdTermScroll( term, -1 );
+        }
+
+        else
+        {
+          term->cy--;
+        }
+        break;
+
+      case 'c':
+        memset( term->lines, ' ', sizeof( term->lines ) );
+        term->stored = 0;
+        term->view = 0;
+        termMove( term, 0, 0 );
+        break;
+    }
+    return;
+  }
+
+  if ( term->state == TERM_CSI )
+  {
+    if ( character >= '0' && character <= '9' )
+    {
+      if ( term->paramCount == 0 )
+      {
+        term->paramCount = 1;
+      }
+
+      if ( term->paramCount <= LCD_TERM_PARAMS )
+      {
+        int *param = &term->params[ term->paramCount - 1 ];
+        *param = MIN( *param * 10 + ( character - '0' ), 9999 );
+      }
+    }
+
+    else if ( character == ';' )
+    {
+      term->paramCount = MAX( term->paramCount, 1 ) + 1;
+    }
+
+    else if ( character == '?' )
+    {
+      term->privateMode = 1;
+    }
+
+    else if ( character >= 0x40 && character <= 0x7E )
+    {
+      term->state = TERM_NORMAL;
+      termCsi( term, character );
+    }
+
+    else if ( character == 0x1B )
+    {
+      term->state = TERM_ESCAPE;
+    }
+    return;
+  }
+
+  switch ( character )
+  {
+    case 0x1B:
+      term->state = TERM_ESCAPE;
+      return;
+
+    case '\n':
+      term->cx = 0;
+      term->wrapPending = 0;
+      termIndex( term );
+      return;
+
+    case '\r':
+      term->cx = 0;
+      term->wrapPending = 0;
+      return;
+
+    case '\b':
+      termMove( term, term->cx - 1, term->cy );
+      return;
+
+    case '\t':
+      termMove( term, ( term->cx / LCD_TERM_TAB + 1 ) * LCD_TERM_TAB, term->cy );
+      return;
+  }
+
+  if ( character < 0x20 || character == 0x7F )
+  {
+    return;
+  }
+
+  if ( term->wrapPending )
+  {
+    term->cx = 0;
+    term->wrapPending = 0;
+    termIndex( term );
+  }
+
+  termLine( term, term->cy )[ term->cx ] = character;
+
+  if ( term->cx == term->cols - 1 )
+  {
+    term->wrapPending = 1;
+  }
+
+  else
+  {
+    term->cx++;
+  }
+}
+
+/*
+ * Feed a buffer to the terminal and render it
+ *
+ * Parameters:
+ *  term  : terminal
+ *  buffer: output bytes
+ *  length: number of bytes
+ *
+ * Return:
+ *  number of bus writes made
+ **************************************************************
+ */
+
+int lcdTermWrite( LcdTerm *term, const char *buffer, int length )
+{
+  term->view = 0; //new output snaps back to the live screen
+
+  for ( int i = 0; i < length; i++ )
+  {
+    lcdTermPutChar( term, buffer[ i ] );
+  }
+
+  return lcdTermRender( term );
+}
+
+/*
+ * Print a string to the terminal
+ *
+ * Parameters:
+ *  term  : terminal
+ *  string: string
+ *
+ * Return:
+ *  number of bus writes made
+ **************************************************************
+ */
+
+int lcdTermPuts( LcdTerm *term, const char *string )
+{
+  return lcdTermWrite( term, string, strlen( string ) );
+}
+
+/*
+ * Print a formated string to the terminal
+ *
+ * Parameters:
+ *  term  : terminal
+ *  string: formated string
+ *
+ * Return:
+ *  number of bus writes made
+ **************************************************************
+ */
+
+int lcdTermPrintf( LcdTerm *term, const char *string, ... )
+{
+  char buffer[ 1024 ];
+  va_list args;
+
+  va_start( args, string );
+  vsnprintf( buffer, sizeof( buffer ), string, args );
+  va_end( args );
+
+  return lcdTermPuts( term, buffer );
+}
+
+/*
+ * Scroll the screen. Only the ring index moves; lines scrolled off the
+ * top are kept as scrollback.
+ *
+ * Parameters:
+ *  term : terminal
+ *  lines: lines to scroll, positive moves text up, negative down
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdTermScroll( LcdTerm *term, int lines )
+{
+  for ( ; lines > 0; lines-- )
+  {
+    term->top = ( term->top + 1 ) % LCD_TERM_LINES;
+    term->stored = MIN( term->stored + 1, LCD_TERM_SCROLLBACK );
+    termClear( term, term->rows - 1, 0, term->cols - 1 );
+  }
+
+  for ( ; lines < 0; lines++ )
+  {
+    term->top = ( term->top + LCD_TERM_LINES - 1 ) % LCD_TERM_LINES;
+    term->stored = MAX( term->stored - 1, 0 ); //the oldest scrollback line is reused
+    termClear( term, 0, 0, term->cols - 1 );
+  }
+}
+
+/*
+ * Look back through the scrollback. Takes effect on the next render.
+ *
+ * Parameters:
+ *  term     : terminal
+ *  linesBack: lines above the live screen, 0 = live
+ *
+ * Return:
+ *  void
+ **************************************************************
+ */
+
+void lcdTermView( LcdTerm *term, int linesBack )
+{
+  term->view = MAX( 0, MIN( linesBack, term->stored ) );
+}
+
+/*
+ * Hand the cells that changed since the last render to the lcd's virtual
+ * screen and flush it. A scroll only costs the cells that differ from
+ * the line that was above them.
+ *
+ * Parameters:
+ *  term: terminal
+ *
+ * Return:
+ *  number of bus writes made, 0 in async mode
+ **************************************************************
+ */
+
+int lcdTermRender( LcdTerm *term )
+{
+  int first = term->top + LCD_TERM_LINES - term->view;
+  int writes;
+
+  for ( int y = 0; y < term->rows; y++ )
+  {
+    unsigned char *line = term->lines[ ( first + y ) % LCD_TERM_LINES ];
+
+    for ( int x = 0; x < term->cols; x++ )
+    {
+      if ( line[ x ] != term->shown[ y ][ x ] )
+      {
+        lcdScreenPutChar( term->lcd, x, y, line[ x ] );
+        term->shown[ y ][ x ] = line[ x ];
+      }
+    }
+  }
+
+  writes = lcdFlush( term->lcd );
+
+  if ( term->cursor && term->view == 0 )
+  {
+    lcdPosition( term->lcd, term->cx, term->cy );
+  }
+
+  return writes;
+}
+
+/*
+ * Copy output from a pipe or pty to the terminal until it closes.
+ * Each read is rendered once, so bursts of output share a flush.
+ *
+ * Parameters:
+ *  term: terminal
+ *  fd  : file descriptor to read
+ *
+ * Return:
+ *  0 at end of file, -1 on a read error
+ **************************************************************
+ */
+
+int lcdTermRun( LcdTerm *term, int fd )
+{
+  char buffer[ 256 ];
+
+  for (;;)
+  {
+    int length = read( fd, buffer, sizeof( buffer ) );
+
+    if ( length == 0 )
+    {
+      return 0;
+    }
+
+    if ( length < 0 )
+    {
+      if ( errno == EINTR )
+      {
+        continue;
+      }
+
+      printf( "Failed: to read terminal input: %s\n", strerror( errno ) );
+      return -1;
+    }
+
+    lcdTermWrite( term, buffer, length );
+  }
+}
+